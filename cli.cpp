@@ -0,0 +1,436 @@
+// Command-line front end to the library for big JSON and NDJSON files.
+//   g++ -std=c++20 -O2 cli.cpp json*.cpp -o jsontool -lpthread -lz
+//
+//   jsontool validate [--ndjson] FILE     checks the syntax
+//   jsontool pretty [--ndjson] FILE       prints like json::Print
+//   jsontool minify [--ndjson] FILE       removes whitespace outside strings
+//   jsontool get POINTER [--ndjson] FILE  prints the value at a JSON Pointer
+//   jsontool count [--ndjson] FILE        counts root members, or NDJSON lines
+//                                         without checking them
+//   jsontool dedup [--key POINTER] FILE   drops repeated NDJSON records, by key
+//                                         or by content
+//
+// FILE is mapped into memory; "-" or no FILE reads standard input. NDJSON is
+// processed on --threads N threads (all cores by default), a batch of blocks at
+// a time, with the output kept in input order. --stats prints throughput and
+// peak memory to standard error. Exit status is 1 for invalid input or a
+// missing value, 2 for usage errors.
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if __has_include(<sys/resource.h>)
+#include <sys/resource.h>
+#define JSON_HAS_RUSAGE 1
+#endif
+
+#include "json.h"
+#include "json_dedup.h"
+#include "json_mapped_file.h"
+#include "json_projection.h"
+#include "json_tokenizer.h"
+#include "json_workers.h"
+
+using namespace std::literals;
+
+namespace {
+
+// Input the user has to fix, reported without a usage message
+class InputError : public std::runtime_error {
+public:
+    using runtime_error::runtime_error;
+};
+
+class UsageError : public std::runtime_error {
+public:
+    using runtime_error::runtime_error;
+};
+
+struct Options {
+    std::string command;
+    std::string pointer;
+    std::string key;
+    std::string path = "-";
+    bool ndjson = false;
+    bool stats = false;
+    unsigned threads = 0;
+};
+
+// NDJSON blocks handed to one thread
+const size_t kBlockSize = 1 << 20;
+// Output is passed on in pieces of about this size
+const size_t kFlushSize = 1 << 20;
+
+void Write(std::string& out, bool force = false) {
+    if (force || out.size() >= kFlushSize) {
+        std::cout.write(out.data(), out.size());
+        out.clear();
+    }
+}
+
+// Whitespace-free copy of valid JSON text. Runs on the worker threads, so it
+// only appends: output is written in order by the main thread.
+void AppendMinified(std::string& out, std::string_view text) {
+    const char* p = text.data();
+    const char* end = p + text.size();
+    while (p != end) {
+        p = json::detail::SkipWhitespace(p, end);
+        if (p == end) {
+            break;
+        }
+        const char c = *p++;
+        out += c;
+        if (c == '"') {
+            // The text is valid, so the string ends before the text does
+            while (true) {
+                const char* run_end = json::detail::FindStringSpecial(p, end);
+                out.append(p, run_end + 1);
+                p = run_end + 1;
+                if (*run_end == '"') {
+                    break;
+                }
+                out += *p++;
+            }
+        }
+    }
+}
+
+// Checks a whole document, nothing but whitespace may follow it
+void Validate(std::string_view text) {
+    json::detail::BufferSource src(text.data(), text.data() + text.size());
+    try {
+        json::detail::SkipValue(src, json::LoadOptions{}.max_depth);
+        src.SkipWhitespace();
+        if (src.Peek() != json::detail::BufferSource::kEof) {
+            throw json::ParsingError("Unexpected text after the document");
+        }
+    } catch (const json::ParsingError& e) {
+        throw InputError("offset " + std::to_string(src.Position()) + ": " + e.what());
+    }
+}
+
+// Elements of a root array or members of a root dict, 1 for a scalar
+uint64_t CountRoot(std::string_view text) {
+    json::detail::BufferSource src(text.data(), text.data() + text.size());
+    src.SkipWhitespace();
+    const int open = src.Peek();
+    if (open != '[' && open != '{') {
+        Validate(text);
+        return 1;
+    }
+    src.Get();
+    uint64_t count = 0;
+    try {
+        src.SkipWhitespace();
+        if (src.Peek() == (open == '[' ? ']' : '}')) {
+            src.Get();
+        } else {
+            while (true) {
+                if (open == '{') {
+                    src.SkipWhitespace();
+                    if (src.Get() != '"') {
+                        throw json::ParsingError("Dict key should start with \"");
+                    }
+                    json::detail::SkipString(src);
+                    src.SkipWhitespace();
+                    if (src.Get() != ':') {
+                        throw json::ParsingError("Expected ':' after dict key");
+                    }
+                }
+                json::detail::SkipValue(src, json::LoadOptions{}.max_depth - 1);
+                ++count;
+                src.SkipWhitespace();
+                const int next = src.Get();
+                if (next == (open == '[' ? ']' : '}')) {
+                    break;
+                } else if (next != ',') {
+                    throw json::ParsingError("Expected ',' or the end of the root");
+                }
+            }
+        }
+        src.SkipWhitespace();
+        if (src.Peek() != json::detail::BufferSource::kEof) {
+            throw json::ParsingError("Unexpected text after the document");
+        }
+    } catch (const json::ParsingError& e) {
+        throw InputError("offset " + std::to_string(src.Position()) + ": " + e.what());
+    }
+    return count;
+}
+
+struct BlockResult {
+    std::string output;
+    uint64_t lines = 0;
+    uint64_t records = 0;
+    // Line within the block and message of the first malformed record
+    std::optional<std::pair<uint64_t, std::string>> error;
+};
+
+// Calls fn(record, output) for every non-blank NDJSON line on the worker
+// threads, a batch of blocks at a time, and writes the outputs in input order.
+// Stops at the first malformed record. Returns the number of records.
+template <typename Fn>
+uint64_t ProcessLines(std::string_view text, unsigned threads, Fn fn) {
+    uint64_t line_number = 0;
+    uint64_t records = 0;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        std::vector<std::string_view> blocks;
+        while (pos < text.size() && blocks.size() < size_t{threads} * 4) {
+            const size_t line_end = text.find('\n', std::min(text.size(), pos + kBlockSize - 1));
+            const size_t end = line_end == std::string_view::npos ? text.size() : line_end + 1;
+            blocks.push_back(text.substr(pos, end - pos));
+            pos = end;
+        }
+
+        std::vector<BlockResult> results(blocks.size());
+        json::detail::ParallelFor(blocks.size(), threads, [&](size_t i) {
+            BlockResult& result = results[i];
+            std::string_view block = blocks[i];
+            while (!block.empty()) {
+                const size_t end = block.find('\n');
+                std::string_view line = block.substr(0, end);
+                block.remove_prefix(end == std::string_view::npos ? block.size() : end + 1);
+                ++result.lines;
+                if (json::detail::SkipWhitespace(line.data(), line.data() + line.size()) == line.data() + line.size()) {
+                    continue;
+                }
+                try {
+                    fn(line, result.output);
+                    ++result.records;
+                } catch (const json::ParsingError& e) {
+                    result.error.emplace(result.lines, e.what());
+                    return;
+                }
+            }
+        });
+
+        for (BlockResult& result : results) {
+            Write(result.output, true);
+            if (result.error) {
+                throw InputError("line " + std::to_string(line_number + result.error->first) + ": "
+                                 + result.error->second);
+            }
+            line_number += result.lines;
+            records += result.records;
+        }
+    }
+    return records;
+}
+
+void CheckRecord(std::string_view line) {
+    json::detail::BufferSource src(line.data(), line.data() + line.size());
+    json::detail::SkipValue(src, json::LoadOptions{}.max_depth);
+    src.SkipWhitespace();
+    if (src.Peek() != json::detail::BufferSource::kEof) {
+        throw json::ParsingError("Unexpected text after the record");
+    }
+}
+
+int RunNdjson(const Options& options, std::string_view text) {
+    const unsigned threads = json::detail::ResolveThreads(options.threads);
+    if (options.command == "validate"sv) {
+        const uint64_t records = ProcessLines(text, threads, [](std::string_view line, std::string&) {
+            CheckRecord(line);
+        });
+        std::cerr << records << " valid records" << std::endl;
+    } else if (options.command == "pretty"sv) {
+        ProcessLines(text, threads, [](std::string_view line, std::string& out) {
+            CheckRecord(line);
+            std::ostringstream printed;
+            json::Print(json::Load(line), printed);
+            out += printed.str();
+            out += '\n';
+        });
+    } else if (options.command == "minify"sv) {
+        ProcessLines(text, threads, [](std::string_view line, std::string& out) {
+            CheckRecord(line);
+            AppendMinified(out, line);
+            out += '\n';
+        });
+    } else if (options.command == "get"sv) {
+        const json::Projection projection({options.pointer});
+        ProcessLines(text, threads, [&projection](std::string_view line, std::string& out) {
+            const std::string_view value = projection.ExtractRaw(line)[0];
+            if (!value.empty()) {
+                AppendMinified(out, value);
+                out += '\n';
+            }
+        });
+    } else if (options.command == "count"sv) {
+        std::cout << ProcessLines(text, threads, [](std::string_view, std::string&) {
+        }) << std::endl;
+    } else if (options.command == "dedup"sv) {
+        json::DedupOptions dedup;
+        dedup.key_path = options.key;
+        dedup.threads = threads;
+        std::string out;
+        const json::DedupStats stats = json::DeduplicateNdjson(text, [&out](std::string_view record) {
+            out += record;
+            out += '\n';
+            Write(out);
+        }, dedup);
+        Write(out, true);
+        std::cerr << stats.records << " records, " << stats.duplicates + stats.probable_duplicates
+                  << " duplicates dropped" << (stats.degraded ? " (approximate past the memory limit)" : "")
+                  << std::endl;
+    }
+    return 0;
+}
+
+int RunDocument(const Options& options, std::string_view text) {
+    std::string out;
+    if (options.command == "validate"sv) {
+        Validate(text);
+    } else if (options.command == "pretty"sv) {
+        Validate(text);
+        json::Print(json::Load(text), std::cout);
+        std::cout << '\n';
+    } else if (options.command == "minify"sv) {
+        Validate(text);
+        AppendMinified(out, text);
+        out += '\n';
+    } else if (options.command == "get"sv) {
+        const std::string_view value = json::Projection({options.pointer}).ExtractRaw(text)[0];
+        if (value.empty()) {
+            std::cerr << "jsontool: no value at " << options.pointer << std::endl;
+            return 1;
+        }
+        AppendMinified(out, value);
+        out += '\n';
+    } else if (options.command == "count"sv) {
+        std::cout << CountRoot(text) << std::endl;
+    }
+    Write(out, true);
+    return 0;
+}
+
+// A positive integer, the whole argument
+unsigned ParseThreads(std::string_view arg) {
+    unsigned threads = 0;
+    const auto [ptr, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), threads);
+    if (ec != std::errc{} || ptr != arg.data() + arg.size() || threads == 0) {
+        throw UsageError("invalid --threads value " + std::string(arg));
+    }
+    return threads;
+}
+
+Options ParseOptions(int argc, char** argv) {
+    Options options;
+    std::vector<std::string_view> positional;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg == "--ndjson"sv) {
+            options.ndjson = true;
+        } else if (arg == "--stats"sv) {
+            options.stats = true;
+        } else if (arg == "--key"sv && i + 1 < argc) {
+            options.key = argv[++i];
+        } else if (arg == "--threads"sv && i + 1 < argc) {
+            options.threads = ParseThreads(argv[++i]);
+        } else if (arg.size() > 2 && arg.substr(0, 2) == "--"sv) {
+            throw UsageError("unknown option " + std::string(arg));
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.empty()) {
+        throw UsageError("no command");
+    }
+    options.command = positional[0];
+    size_t next = 1;
+    if (options.command == "get"sv) {
+        if (positional.size() < 2) {
+            throw UsageError("get needs a JSON Pointer");
+        }
+        options.pointer = positional[next++];
+    } else if (options.command != "validate"sv && options.command != "pretty"sv && options.command != "minify"sv
+               && options.command != "count"sv && options.command != "dedup"sv) {
+        throw UsageError("unknown command " + options.command);
+    }
+    if (next < positional.size()) {
+        options.path = positional[next++];
+    }
+    if (next < positional.size()) {
+        throw UsageError("too many arguments");
+    }
+    return options;
+}
+
+// Peak resident memory in bytes, 0 when unknown
+size_t PeakMemory() {
+#ifdef JSON_HAS_RUSAGE
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return usage.ru_maxrss * 1024;
+#endif
+#else
+    return 0;
+#endif
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::ios::sync_with_stdio(false);
+    Options options;
+    try {
+        options = ParseOptions(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << "jsontool: " << e.what() << "\n"
+                  << "usage: jsontool validate|pretty|minify|count [--ndjson] [--threads N] [--stats] [FILE]\n"
+                  << "       jsontool get POINTER [--ndjson] [--threads N] [--stats] [FILE]\n"
+                  << "       jsontool dedup [--key POINTER] [--threads N] [--stats] [FILE]" << std::endl;
+        return 2;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    int status = 0;
+    size_t bytes = 0;
+    try {
+        std::unique_ptr<json::MappedFile> file;
+        std::string input;
+        std::string_view text;
+        if (options.path == "-"sv) {
+            input.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+            text = input;
+        } else {
+            file = std::make_unique<json::MappedFile>(options.path);
+            text = file->GetText();
+        }
+        bytes = text.size();
+        status = options.ndjson || options.command == "dedup"sv ? RunNdjson(options, text) : RunDocument(options, text);
+    } catch (const InputError& e) {
+        std::cerr << "jsontool: " << options.path << ": " << e.what() << std::endl;
+        status = 1;
+    } catch (const std::invalid_argument& e) {
+        std::cerr << "jsontool: " << e.what() << std::endl;
+        status = 2;
+    } catch (const std::exception& e) {
+        std::cerr << "jsontool: " << options.path << ": " << e.what() << std::endl;
+        status = 1;
+    }
+    std::cout.flush();
+
+    if (options.stats) {
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::fprintf(stderr, "%zu bytes in %.3f s, %.1f MB/s, peak memory %.1f MB\n", bytes, seconds,
+                     seconds > 0 ? bytes / seconds / 1e6 : 0.0, PeakMemory() / 1e6);
+    }
+    return status;
+}
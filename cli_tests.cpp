@@ -0,0 +1,128 @@
+// Runs jsontool on generated inputs and compares its output with the
+// expected text. Built as a separate program from main.cpp, next to jsontool:
+//   g++ -std=c++20 -O2 cli.cpp json*.cpp -o jsontool -lpthread -lz
+//   g++ -std=c++20 -O2 cli_tests.cpp -o cli_tests && ./cli_tests ./jsontool
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+#include <sys/wait.h>
+
+using namespace std::literals;
+
+namespace {
+
+const std::string kInput = "cli_tests_input.json"s;
+const std::string kOutput = "cli_tests_output.json"s;
+
+std::string jsontool;
+
+std::string ReadFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+void WriteFile(const std::string& path, std::string_view text) {
+    std::ofstream file(path, std::ios::binary);
+    file.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+// Exit status of jsontool with the arguments, standard output going to kOutput
+int Status(const std::string& arguments, std::string_view input) {
+    WriteFile(kInput, input);
+    const std::string command = jsontool + " " + arguments + " " + kInput + " > " + kOutput + " 2> /dev/null";
+    const int status = std::system(command.c_str());
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// Standard output of jsontool with the arguments, asserting a zero exit status
+std::string Run(const std::string& arguments, std::string_view input) {
+    const int status = Status(arguments, input);
+    if (status != 0) {
+        std::cerr << "failed: " << arguments << std::endl;
+    }
+    assert(status == 0);
+    return ReadFile(kOutput);
+}
+
+// NDJSON records with escapes, nesting and spaces inside strings; spaced
+// adds whitespace outside the strings. Keys are sorted and numbers written
+// as json::Print writes them, so that pretty keeps the text apart from
+// whitespace.
+std::string Records(size_t count, bool spaced) {
+    const std::string_view colon = spaced ? ": "sv : ":"sv;
+    const std::string_view comma = spaced ? ", "sv : ","sv;
+    std::string text;
+    for (size_t i = 0; i < count; ++i) {
+        const std::string id = std::to_string(i);
+        text += "{\"id\""s.append(colon).append(id).append(comma);
+        text += "\"name\""s.append(colon).append("\"user \\\"").append(id).append("\\\" \\\\ x\"").append(comma);
+        text += "\"nested\""s.append(colon).append("{\"k\"").append(colon).append("[true").append(comma);
+        text += "{\"x \\n y\""s.append(colon).append("-1500.0}]}").append(comma);
+        text += "\"tags\""s.append(colon).append("[\"a b\"").append(comma).append(id).append(comma).append("null]}\n");
+    }
+    return text;
+}
+
+// Several blocks per thread and several output flushes: records must come
+// out whole and in input order
+void TestMinifyNdjson() {
+    const std::string compact = Records(40'000, false);
+    assert(compact.size() > (4u << 20));
+    assert(Run("minify --ndjson --threads 4"s, compact) == compact);
+    assert(Run("minify --ndjson --threads 4"s, Records(40'000, true)) == compact);
+    assert(Run("count --ndjson"s, compact) == "40000\n"s);
+}
+
+// pretty, then minify, gives back the compact document
+void TestRoundTrip() {
+    std::string compact = "["s;
+    const std::string records = Records(20'000, false);
+    for (size_t pos = 0; pos < records.size();) {
+        const size_t end = records.find('\n', pos);
+        if (pos > 0) {
+            compact += ',';
+        }
+        compact.append(records, pos, end - pos);
+        pos = end + 1;
+    }
+    compact += "]\n"s;
+    assert(compact.size() > (1u << 20));
+
+    const std::string pretty = Run("pretty"s, compact);
+    assert(pretty.size() > compact.size());
+    assert(Run("minify"s, pretty) == compact);
+    assert(Run("minify"s, compact) == compact);
+}
+
+// Every command rejects text after the value, as validate does, and bad
+// option values are usage errors
+void TestRejects() {
+    for (const std::string& command : {"validate"s, "pretty"s, "minify"s}) {
+        assert(Status(command, "{\"a\":1} xyz"sv) == 1);
+        assert(Status(command + " --ndjson"s, "{\"a\":1}\n{\"a\":1} xyz\n"sv) == 1);
+    }
+    assert(Run("pretty"s, " {\"a\":1} \n"sv) == "{\n  \"a\": 1\n}\n"s);
+    for (const std::string& value : {"abc"s, "-1"s, "1x"s, "0"s, ""s}) {
+        assert(Status("count --ndjson --threads '"s + value + "'"s, "1\n"sv) == 2);
+    }
+    assert(Run("count --ndjson --threads 3"s, "1\n2\n"sv) == "2\n"s);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    jsontool = argc > 1 ? argv[1] : "./jsontool";
+    TestMinifyNdjson();
+    TestRoundTrip();
+    TestRejects();
+    std::remove(kInput.c_str());
+    std::remove(kOutput.c_str());
+    std::cout << "OK" << std::endl;
+}
@@ -1,13 +1,26 @@
 #pragma once
 
+#include <atomic>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 #include <stdexcept>
 #include <initializer_list>
 
+// Define JSON_HEADER_ONLY (for the whole build) to get the definitions inline
+// from this header instead of linking them from json.cpp
+#ifdef JSON_HEADER_ONLY
+#define JSON_INLINE inline
+#else
+#define JSON_INLINE
+#endif
+
 namespace json {
 
     class Node;
@@ -63,22 +76,88 @@ namespace json {
         bool operator==(const Dict& dict) const;
 
     private:
+        friend class Document;
+
         Value value_;
     };
 
+    namespace detail {
+
+        // Documents parsed from string values of a Document, by the address of
+        // the string Node
+        struct EmbeddedTable {
+            std::mutex mutex;
+            std::map<const Node*, std::unique_ptr<const Node>> documents;
+        };
+
+    }  // namespace detail
+
     class Document {
     public:
         explicit Document(Node root);
         explicit Document(Array array);
         explicit Document(Dict dict);
 
+        // Copies parse embedded documents again when asked for them
+        Document(const Document& other);
+        Document(Document&& other) noexcept;
+        Document& operator=(const Document& other);
+        Document& operator=(Document&& other) noexcept;
+        ~Document();
+
         const Node& GetRoot() const;
 
+        // The JSON document held by a string Node of this document, parsed on
+        // the first call and kept in a table of the Document, not in the Node.
+        // Safe to call from several threads. The result stays valid until the
+        // Document is changed or destroyed. Throws std::logic_error when node
+        // is not a string and ParsingError when it doesn't hold valid JSON.
+        const Node& GetEmbedded(const Node& node) const;
+
+        // Puts value at the JSON Pointer, replacing an existing member or element,
+        // adding a new dict member, or appending to an array for index "-" or size.
+        // Returns the replaced value, nullopt when the value was added.
+        // Throws std::out_of_range when the parent container does not exist.
+        std::optional<Node> Set(std::string_view pointer, Node value);
+        // Removes the member or element at the JSON Pointer and returns it,
+        // nullopt when there was nothing to remove
+        std::optional<Node> Erase(std::string_view pointer);
+
     private:
+        Node* FindParent(const std::vector<std::string>& tokens, std::string_view pointer);
+        detail::EmbeddedTable& GetEmbeddedTable() const;
+        void TakeEmbedded(Document& other);
+        void ClearEmbedded();
+
         Node root_;
+        // Created by the first GetEmbedded call
+        mutable std::atomic<detail::EmbeddedTable*> embedded_{nullptr};
+    };
+
+    struct LoadOptions {
+        // JSON Pointers ("/events/0/payload") to string values holding an
+        // embedded JSON document, which are parsed during loading for
+        // Document::GetEmbedded.
+        // A "*" token matches any key or array index.
+        std::vector<std::string> embedded_json_paths;
+        // Deeper documents fail with ParsingError instead of exhausting the stack
+        size_t max_depth = 1'000;
     };
 
     Document Load(std::istream& input);
+    Document Load(std::istream& input, const LoadOptions& options);
+    // Parses a document held in memory, faster than going through a stream
+    Document Load(std::string_view text);
+    Document Load(std::string_view text, const LoadOptions& options);
+    // Parses the JSON document held by a string Node, without caching it.
+    // Throws std::logic_error when node is not a string.
+    Document ParseEmbedded(const Node& node, size_t max_depth = LoadOptions{}.max_depth);
     void Print(const Document& doc, std::ostream& output);
+    // Prints on a single line without whitespace, e.g. for an NDJSON record
+    void PrintCompact(const Document& doc, std::ostream& output);
 
 }  // namespace json
+
+#ifdef JSON_HEADER_ONLY
+#include "json_inl.h"
+#endif
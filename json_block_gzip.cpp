@@ -0,0 +1,253 @@
+#include "json_block_gzip.h"
+#include "json_detail.h"
+#include "json_workers.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <istream>
+#include <iterator>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace json {
+
+namespace {
+
+const string_view kIndexHeader = "json-block-gzip 1"sv;
+
+// Deflate expands data at most 1032 times
+const uint64_t kMaxDeflateRatio = 1032;
+
+// Whether a block could inflate to the size the index claims. The size decides
+// how much Inflate allocates, so a corrupt index must not get that far.
+bool IsPlausible(const GzipBlock& block) {
+    return block.uncompressed_size / kMaxDeflateRatio <= block.compressed_size;
+}
+
+// zlib counts in uInt, so big buffers are handed over in pieces
+uInt Piece(size_t size) {
+    return static_cast<uInt>(min<size_t>(size, numeric_limits<uInt>::max()));
+}
+
+// One complete gzip member
+string Deflate(string_view text, int level) {
+    z_stream stream{};
+    // 16 + window bits asks for a gzip header and trailer instead of zlib ones
+    if (deflateInit2(&stream, level, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw runtime_error("deflateInit2 failed");
+    }
+    string result(deflateBound(&stream, text.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(text.data()));
+    size_t in_left = text.size();
+    int status = Z_OK;
+    while (status != Z_STREAM_END) {
+        if (stream.avail_in == 0) {
+            stream.avail_in = Piece(in_left);
+            in_left -= stream.avail_in;
+        }
+        if (stream.total_out == result.size()) {
+            result.resize(result.size() * 2);
+        }
+        stream.next_out = reinterpret_cast<Bytef*>(result.data() + stream.total_out);
+        stream.avail_out = Piece(result.size() - stream.total_out);
+        status = deflate(&stream, in_left == 0 ? Z_FINISH : Z_NO_FLUSH);
+        if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR) {
+            deflateEnd(&stream);
+            throw runtime_error("deflate failed");
+        }
+    }
+    result.resize(stream.total_out);
+    deflateEnd(&stream);
+    return result;
+}
+
+// Inflates a gzip member into exactly size bytes, false if it doesn't fit
+bool Inflate(string_view member, string& out, size_t size) {
+    z_stream stream{};
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
+        throw runtime_error("inflateInit2 failed");
+    }
+    out.resize(size);
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(member.data()));
+    size_t in_left = member.size();
+    int status = Z_OK;
+    while (status == Z_OK) {
+        if (stream.avail_in == 0) {
+            stream.avail_in = Piece(in_left);
+            in_left -= stream.avail_in;
+        }
+        stream.next_out = reinterpret_cast<Bytef*>(out.data() + stream.total_out);
+        stream.avail_out = Piece(size - stream.total_out);
+        status = inflate(&stream, Z_NO_FLUSH);
+    }
+    const bool ok = status == Z_STREAM_END && stream.total_out == size && stream.avail_in == 0 && in_left == 0;
+    inflateEnd(&stream);
+    return ok;
+}
+
+}  // namespace
+
+void SaveBlockIndex(const BlockIndex& index, ostream& output) {
+    output << kIndexHeader << '\n';
+    for (const GzipBlock& block : index) {
+        output << block.offset << ' ' << block.compressed_size << ' ' << block.uncompressed_size << ' '
+               << block.first_record << ' ' << block.record_count << '\n';
+    }
+}
+
+BlockIndex LoadBlockIndex(istream& input) {
+    string line;
+    if (!getline(input, line) || line != kIndexHeader) {
+        throw ParsingError("Not a block gzip index");
+    }
+    BlockIndex index;
+    while (getline(input, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        istringstream fields(line);
+        GzipBlock block;
+        if (!(fields >> block.offset >> block.compressed_size >> block.uncompressed_size >> block.first_record
+                     >> block.record_count)
+            || !(fields >> ws).eof()) {
+            throw ParsingError("Malformed block index line: " + line);
+        }
+        if (!IsPlausible(block)) {
+            throw ParsingError("Block index line claims more than the block can inflate to: " + line);
+        }
+        index.push_back(block);
+    }
+    return index;
+}
+
+BlockGzipWriter::BlockGzipWriter(ostream& output, const BlockGzipOptions& options)
+    : output_(output)
+    , options_(options) {
+}
+
+void BlockGzipWriter::Write(const Document& record) {
+    detail::AppendCompact(pending_, record.GetRoot());
+    pending_ += '\n';
+    ++pending_records_;
+    if (pending_.size() >= options_.block_size) {
+        FlushBlock();
+    }
+}
+
+void BlockGzipWriter::WriteRaw(string_view record) {
+    if (record.empty() || record.find_first_of("\r\n"sv) != string_view::npos) {
+        throw invalid_argument("An NDJSON record should be a single non-empty line");
+    }
+    pending_ += record;
+    pending_ += '\n';
+    ++pending_records_;
+    if (pending_.size() >= options_.block_size) {
+        FlushBlock();
+    }
+}
+
+const BlockIndex& BlockGzipWriter::Finish() {
+    FlushBlock();
+    output_.flush();
+    return index_;
+}
+
+void BlockGzipWriter::FlushBlock() {
+    if (pending_records_ == 0) {
+        return;
+    }
+    const string member = Deflate(pending_, options_.level);
+    output_.write(member.data(), member.size());
+    if (!output_) {
+        throw runtime_error("Failed to write a gzip block");
+    }
+    index_.push_back({offset_, member.size(), pending_.size(), records_, pending_records_});
+    offset_ += member.size();
+    records_ += pending_records_;
+    pending_.clear();
+    pending_records_ = 0;
+}
+
+BlockGzipReader::BlockGzipReader(string_view data, BlockIndex index)
+    : data_(data)
+    , index_(std::move(index)) {
+    uint64_t offset = 0;
+    uint64_t records = 0;
+    for (const GzipBlock& block : index_) {
+        if (block.offset != offset || block.first_record != records || block.record_count == 0) {
+            throw invalid_argument("Block index is not contiguous");
+        }
+        if (!IsPlausible(block)) {
+            throw invalid_argument("Block index claims more than a block can inflate to");
+        }
+        offset += block.compressed_size;
+        records += block.record_count;
+    }
+    if (offset != data_.size()) {
+        throw invalid_argument("Block index doesn't cover the data");
+    }
+}
+
+uint64_t BlockGzipReader::RecordCount() const {
+    return index_.empty() ? 0 : index_.back().first_record + index_.back().record_count;
+}
+
+const BlockIndex& BlockGzipReader::GetIndex() const {
+    return index_;
+}
+
+string BlockGzipReader::Decompress(size_t block) const {
+    const GzipBlock& info = index_.at(block);
+    string text;
+    if (!Inflate(data_.substr(info.offset, info.compressed_size), text, info.uncompressed_size)) {
+        throw ParsingError("Corrupt gzip block " + to_string(block));
+    }
+    return text;
+}
+
+vector<Document> BlockGzipReader::Read(uint64_t first, uint64_t count, const BlockGzipReadOptions& options) const {
+    const uint64_t end = first + min(count, RecordCount() - min(first, RecordCount()));
+    if (first >= end) {
+        return {};
+    }
+    auto by_first_record = [](uint64_t record, const GzipBlock& block) {
+        return record < block.first_record;
+    };
+    const size_t first_block = upper_bound(index_.begin(), index_.end(), first, by_first_record) - index_.begin() - 1;
+    const size_t end_block = upper_bound(index_.begin(), index_.end(), end - 1, by_first_record) - index_.begin();
+
+    vector<vector<Document>> parts(end_block - first_block);
+    detail::ParallelFor(parts.size(), detail::ResolveThreads(options.threads), [&](size_t i) {
+        const size_t block = first_block + i;
+        const GzipBlock& info = index_[block];
+        const string text = Decompress(block);
+        uint64_t record = info.first_record;
+        detail::ForEachRecord(text, [&](string_view line) {
+            if (record >= first && record < end) {
+                parts[i].push_back(Load(line, options.load));
+            }
+            ++record;
+        });
+        if (record != info.first_record + info.record_count) {
+            throw ParsingError("Block " + to_string(block) + " doesn't hold the indexed number of records");
+        }
+    });
+
+    vector<Document> result;
+    result.reserve(end - first);
+    for (vector<Document>& part : parts) {
+        move(part.begin(), part.end(), back_inserter(result));
+    }
+    return result;
+}
+
+vector<Document> BlockGzipReader::ReadAll(const BlockGzipReadOptions& options) const {
+    return Read(0, RecordCount(), options);
+}
+
+}  // namespace json
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "json.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// NDJSON compressed as a sequence of independent gzip members, one per block of
+// whole records. The file stays readable by gzip/zcat (multi-member gzip),
+// while a sidecar index of the blocks lets a reader decompress and parse them
+// on several threads and jump straight to a range of records.
+// Needs zlib (-lz).
+
+namespace json {
+
+    struct GzipBlock {
+        // Position and size of the gzip member in the file
+        uint64_t offset = 0;
+        uint64_t compressed_size = 0;
+        uint64_t uncompressed_size = 0;
+        // Records of the file stored in this block
+        uint64_t first_record = 0;
+        uint64_t record_count = 0;
+    };
+
+    using BlockIndex = std::vector<GzipBlock>;
+
+    // The sidecar: a header line and one text line per block
+    void SaveBlockIndex(const BlockIndex& index, std::ostream& output);
+    // Throws ParsingError on a malformed index, also on a block claiming more
+    // uncompressed bytes than deflate can produce from its compressed size
+    BlockIndex LoadBlockIndex(std::istream& input);
+
+    struct BlockGzipOptions {
+        // A block is closed at the first record boundary past this many
+        // uncompressed bytes
+        size_t block_size = 1 << 20;
+        // zlib level, 1 (fastest) to 9 (smallest)
+        int level = 6;
+    };
+
+    // Writes records to a binary stream. Call Finish to write the last block
+    // and get the index; records written after Finish start a new block.
+    class BlockGzipWriter {
+    public:
+        explicit BlockGzipWriter(std::ostream& output, const BlockGzipOptions& options = {});
+
+        // Writes the record on one line, as PrintCompact does
+        void Write(const Document& record);
+        // Writes an already serialized record. Throws std::invalid_argument
+        // when it is empty or contains a line break.
+        void WriteRaw(std::string_view record);
+
+        const BlockIndex& Finish();
+
+    private:
+        void FlushBlock();
+
+        std::ostream& output_;
+        BlockGzipOptions options_;
+        std::string pending_;
+        uint64_t pending_records_ = 0;
+        uint64_t offset_ = 0;
+        uint64_t records_ = 0;
+        BlockIndex index_;
+    };
+
+    struct BlockGzipReadOptions {
+        LoadOptions load;
+        // 0 means std::thread::hardware_concurrency()
+        unsigned threads = 0;
+    };
+
+    // Reads a block-compressed file held in memory (e.g. mapped), which must
+    // outlive the reader. Corrupt blocks and records fail with ParsingError.
+    class BlockGzipReader {
+    public:
+        // Throws std::invalid_argument when the index doesn't fit the data or
+        // claims more uncompressed bytes than a block can hold
+        BlockGzipReader(std::string_view data, BlockIndex index);
+
+        uint64_t RecordCount() const;
+        const BlockIndex& GetIndex() const;
+
+        // Records [first, first + count), clipped to the end of the file. Only
+        // the blocks holding them are decompressed, concurrently.
+        std::vector<Document> Read(uint64_t first, uint64_t count, const BlockGzipReadOptions& options = {}) const;
+        std::vector<Document> ReadAll(const BlockGzipReadOptions& options = {}) const;
+
+        // NDJSON text of one block. Throws ParsingError unless it inflates to
+        // exactly the indexed size.
+        std::string Decompress(size_t block) const;
+
+    private:
+        std::string_view data_;
+        BlockIndex index_;
+    };
+
+}  // namespace json
@@ -0,0 +1,373 @@
+#include "json_block_stats.h"
+#include "json_detail.h"
+#include "json_projection.h"
+#include "json_workers.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <istream>
+#include <iterator>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace json {
+
+namespace {
+
+const string_view kStatsHeader = "json-block-stats 1"sv;
+
+// Number at a projected position, nullopt for anything else
+optional<double> NumberAt(string_view raw) {
+    if (raw.empty() || !(raw.front() == '-' || (raw.front() >= '0' && raw.front() <= '9'))) {
+        return nullopt;
+    }
+    return Load(raw).GetRoot().AsDouble();
+}
+
+optional<string> StringAt(string_view raw) {
+    if (raw.empty() || raw.front() != '"') {
+        return nullopt;
+    }
+    return Load(raw).GetRoot().AsString();
+}
+
+// Byte ranges of the blocks, cut after a line break
+vector<pair<size_t, size_t>> SplitBlocks(string_view text, size_t block_size) {
+    vector<pair<size_t, size_t>> blocks;
+    for (size_t start = 0; start < text.size();) {
+        const size_t line_end = text.find('\n', start + max<size_t>(block_size, 1) - 1);
+        const size_t end = line_end == string_view::npos ? text.size() : line_end + 1;
+        blocks.emplace_back(start, end);
+        start = end;
+    }
+    return blocks;
+}
+
+string FormatDouble(double value) {
+    char buf[32];
+    auto [ptr, ec] = to_chars(buf, buf + sizeof(buf), value);
+    return string(buf, ptr);
+}
+
+template <typename T>
+T ParseNumber(string_view text) {
+    T value{};
+    auto [ptr, ec] = from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != errc{} || ptr != text.data() + text.size()) {
+        throw ParsingError("Malformed number in block stats: " + string(text));
+    }
+    return value;
+}
+
+// Fields of a sidecar line after its tag
+vector<string_view> Fields(string_view line) {
+    vector<string_view> fields;
+    while (!line.empty()) {
+        const size_t end = line.find(' ');
+        if (end != 0) {
+            fields.push_back(line.substr(0, end));
+        }
+        line.remove_prefix(end == string_view::npos ? line.size() : end + 1);
+    }
+    return fields;
+}
+
+void CheckCoverage(string_view text, const BlockStatsIndex& index) {
+    uint64_t offset = 0;
+    for (const BlockStats& block : index.blocks) {
+        if (block.offset != offset) {
+            throw invalid_argument("Block stats are not contiguous");
+        }
+        offset += block.size;
+    }
+    if (offset != text.size()) {
+        throw invalid_argument("Block stats don't cover the text");
+    }
+}
+
+}  // namespace
+
+BloomFilter::BloomFilter(size_t expected_items, double false_positive_rate) {
+    if (!(false_positive_rate > 0 && false_positive_rate < 1)) {
+        throw invalid_argument("Bloom filter false positive rate must be in (0, 1)");
+    }
+    const double items = static_cast<double>(max<size_t>(expected_items, 1));
+    const double ln2 = log(2.0);
+    const double bits = ceil(-items * log(false_positive_rate) / (ln2 * ln2));
+    words_.assign(max<size_t>(static_cast<size_t>(bits + 63) / 64, 1), 0);
+    const double per_item = static_cast<double>(words_.size() * 64) / items;
+    hashes_ = clamp<unsigned>(static_cast<unsigned>(lround(per_item * ln2)), 1, 16);
+}
+
+// Double hashing: bit i is h1 + i * h2, both from one 64-bit hash
+void BloomFilter::Add(string_view value) {
+    const uint64_t hash = detail::Hash64(value);
+    const uint64_t bits = words_.size() * 64;
+    for (unsigned i = 0; i < hashes_; ++i) {
+        const uint64_t bit = (hash + i * ((hash >> 32) | 1)) % bits;
+        words_[bit / 64] |= uint64_t{1} << (bit % 64);
+    }
+}
+
+bool BloomFilter::MayContain(string_view value) const {
+    if (words_.empty()) {
+        return true;
+    }
+    const uint64_t hash = detail::Hash64(value);
+    const uint64_t bits = words_.size() * 64;
+    for (unsigned i = 0; i < hashes_; ++i) {
+        const uint64_t bit = (hash + i * ((hash >> 32) | 1)) % bits;
+        if ((words_[bit / 64] & (uint64_t{1} << (bit % 64))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+string BloomFilter::ToHex() const {
+    static const char kDigits[] = "0123456789abcdef";
+    string hex;
+    hex.reserve(words_.size() * 16);
+    for (uint64_t word : words_) {
+        for (int shift = 60; shift >= 0; shift -= 4) {
+            hex += kDigits[(word >> shift) & 0xF];
+        }
+    }
+    return hex;
+}
+
+BloomFilter BloomFilter::FromHex(unsigned hashes, string_view hex) {
+    if (hex.empty() || hex.size() % 16 != 0 || hashes == 0) {
+        throw ParsingError("Malformed bloom filter");
+    }
+    BloomFilter filter;
+    filter.hashes_ = hashes;
+    for (size_t pos = 0; pos < hex.size(); pos += 16) {
+        uint64_t word = 0;
+        auto [ptr, ec] = from_chars(hex.data() + pos, hex.data() + pos + 16, word, 16);
+        if (ec != errc{} || ptr != hex.data() + pos + 16) {
+            throw ParsingError("Malformed bloom filter");
+        }
+        filter.words_.push_back(word);
+    }
+    return filter;
+}
+
+unsigned BloomFilter::GetHashCount() const {
+    return hashes_;
+}
+
+BlockStatsIndex BuildBlockStats(string_view text, const BlockStatsOptions& options) {
+    // Checked up front, also for blocks that end up without string paths
+    BloomFilter(1, options.false_positive_rate);
+    BlockStatsIndex index;
+    index.numeric_paths = options.numeric_paths;
+    index.string_paths = options.string_paths;
+
+    vector<string> paths = options.numeric_paths;
+    paths.insert(paths.end(), options.string_paths.begin(), options.string_paths.end());
+    const Projection projection(paths);
+    const size_t numeric_count = options.numeric_paths.size();
+
+    const vector<pair<size_t, size_t>> ranges = SplitBlocks(text, options.block_size);
+    index.blocks.resize(ranges.size());
+    detail::ParallelFor(ranges.size(), detail::ResolveThreads(options.threads), [&](size_t i) {
+        BlockStats& block = index.blocks[i];
+        block.offset = ranges[i].first;
+        block.size = ranges[i].second - ranges[i].first;
+        block.numbers.resize(numeric_count);
+        vector<vector<string>> strings(options.string_paths.size());
+
+        vector<string_view> values;
+        detail::ForEachRecord(text.substr(block.offset, block.size), [&](string_view record) {
+            ++block.records;
+            projection.ExtractRaw(record, values);
+            for (size_t j = 0; j < numeric_count; ++j) {
+                if (optional<double> number = NumberAt(values[j])) {
+                    NumericStats& stats = block.numbers[j];
+                    stats.min = stats.count == 0 ? *number : min(stats.min, *number);
+                    stats.max = stats.count == 0 ? *number : max(stats.max, *number);
+                    ++stats.count;
+                }
+            }
+            for (size_t j = 0; j < strings.size(); ++j) {
+                if (optional<string> value = StringAt(values[numeric_count + j])) {
+                    strings[j].push_back(std::move(*value));
+                }
+            }
+        });
+
+        for (vector<string>& values_at_path : strings) {
+            sort(values_at_path.begin(), values_at_path.end());
+            values_at_path.erase(unique(values_at_path.begin(), values_at_path.end()), values_at_path.end());
+            BloomFilter& filter = block.strings.emplace_back(values_at_path.size(), options.false_positive_rate);
+            for (const string& value : values_at_path) {
+                filter.Add(value);
+            }
+        }
+    });
+    return index;
+}
+
+void SaveBlockStats(const BlockStatsIndex& index, ostream& output) {
+    output << kStatsHeader << '\n';
+    string path;
+    for (const string& pointer : index.numeric_paths) {
+        path.clear();
+        detail::AppendString(path, pointer);
+        output << "numeric " << path << '\n';
+    }
+    for (const string& pointer : index.string_paths) {
+        path.clear();
+        detail::AppendString(path, pointer);
+        output << "string " << path << '\n';
+    }
+    for (const BlockStats& block : index.blocks) {
+        output << "block " << block.offset << ' ' << block.size << ' ' << block.records << '\n';
+        for (const NumericStats& stats : block.numbers) {
+            output << "range " << stats.count << ' ' << FormatDouble(stats.min) << ' ' << FormatDouble(stats.max)
+                   << '\n';
+        }
+        for (const BloomFilter& filter : block.strings) {
+            output << "bloom " << filter.GetHashCount() << ' ' << filter.ToHex() << '\n';
+        }
+    }
+}
+
+BlockStatsIndex LoadBlockStats(istream& input) {
+    string line;
+    if (!getline(input, line) || line != kStatsHeader) {
+        throw ParsingError("Not a block stats index");
+    }
+    BlockStatsIndex index;
+    auto check_block = [&index] {
+        if (!index.blocks.empty()
+            && (index.blocks.back().numbers.size() != index.numeric_paths.size()
+                || index.blocks.back().strings.size() != index.string_paths.size())) {
+            throw ParsingError("Block stats don't match the paths");
+        }
+    };
+    while (getline(input, line)) {
+        const size_t space = line.find(' ');
+        const string_view tag = string_view(line).substr(0, space);
+        const string_view rest = space == string::npos ? string_view{} : string_view(line).substr(space + 1);
+        if ((tag == "numeric"sv || tag == "string"sv) && index.blocks.empty()) {
+            const Node path = Load(rest).GetRoot();
+            if (!path.IsString()) {
+                throw ParsingError("Malformed path in block stats: " + line);
+            }
+            (tag == "numeric"sv ? index.numeric_paths : index.string_paths).push_back(path.AsString());
+            continue;
+        }
+        const vector<string_view> fields = Fields(rest);
+        if (tag == "block"sv && fields.size() == 3) {
+            check_block();
+            BlockStats& block = index.blocks.emplace_back();
+            block.offset = ParseNumber<uint64_t>(fields[0]);
+            block.size = ParseNumber<uint64_t>(fields[1]);
+            block.records = ParseNumber<uint64_t>(fields[2]);
+        } else if (tag == "range"sv && fields.size() == 3 && !index.blocks.empty()) {
+            index.blocks.back().numbers.push_back(
+                {ParseNumber<uint64_t>(fields[0]), ParseNumber<double>(fields[1]), ParseNumber<double>(fields[2])});
+        } else if (tag == "bloom"sv && fields.size() == 2 && !index.blocks.empty()) {
+            index.blocks.back().strings.push_back(BloomFilter::FromHex(ParseNumber<unsigned>(fields[0]), fields[1]));
+        } else if (!line.empty()) {
+            throw ParsingError("Malformed block stats line: " + line);
+        }
+    }
+    check_block();
+    return index;
+}
+
+vector<size_t> CandidateBlocks(const BlockStatsIndex& index, const ScanFilter& filter) {
+    auto position = [](const vector<string>& paths, const string& path) -> optional<size_t> {
+        auto it = find(paths.begin(), paths.end(), path);
+        return it == paths.end() ? nullopt : optional<size_t>(it - paths.begin());
+    };
+    vector<pair<size_t, const ScanFilter::Range*>> ranges;
+    for (const ScanFilter::Range& range : filter.ranges) {
+        if (optional<size_t> j = position(index.numeric_paths, range.path)) {
+            ranges.emplace_back(*j, &range);
+        }
+    }
+    vector<pair<size_t, const ScanFilter::Equals*>> equals;
+    for (const ScanFilter::Equals& condition : filter.equals) {
+        if (optional<size_t> j = position(index.string_paths, condition.path)) {
+            equals.emplace_back(*j, &condition);
+        }
+    }
+
+    vector<size_t> candidates;
+    for (size_t i = 0; i < index.blocks.size(); ++i) {
+        const BlockStats& block = index.blocks[i];
+        const bool skip = any_of(ranges.begin(), ranges.end(),
+                                 [&block](const auto& range) {
+                                     const NumericStats& stats = block.numbers[range.first];
+                                     return stats.count == 0 || stats.max < range.second->min
+                                            || stats.min > range.second->max;
+                                 })
+                          || any_of(equals.begin(), equals.end(), [&block](const auto& condition) {
+                                 return !block.strings[condition.first].MayContain(condition.second->value);
+                             });
+        if (!skip) {
+            candidates.push_back(i);
+        }
+    }
+    return candidates;
+}
+
+ScanResult Scan(string_view text, const BlockStatsIndex& index, const ScanFilter& filter, const ScanOptions& options) {
+    CheckCoverage(text, index);
+    const vector<size_t> candidates = CandidateBlocks(index, filter);
+
+    vector<string> paths;
+    for (const ScanFilter::Range& range : filter.ranges) {
+        paths.push_back(range.path);
+    }
+    for (const ScanFilter::Equals& condition : filter.equals) {
+        paths.push_back(condition.path);
+    }
+    const Projection projection(paths);
+    auto matches = [&filter](const vector<string_view>& values) {
+        for (size_t j = 0; j < filter.ranges.size(); ++j) {
+            const optional<double> number = NumberAt(values[j]);
+            if (!number || *number < filter.ranges[j].min || *number > filter.ranges[j].max) {
+                return false;
+            }
+        }
+        for (size_t j = 0; j < filter.equals.size(); ++j) {
+            const optional<string> value = StringAt(values[filter.ranges.size() + j]);
+            if (!value || *value != filter.equals[j].value) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    vector<vector<Document>> parts(candidates.size());
+    detail::ParallelFor(candidates.size(), detail::ResolveThreads(options.threads), [&](size_t i) {
+        const BlockStats& block = index.blocks[candidates[i]];
+        vector<string_view> values;
+        detail::ForEachRecord(text.substr(block.offset, block.size), [&](string_view record) {
+            projection.ExtractRaw(record, values);
+            if (matches(values)) {
+                parts[i].push_back(Load(record, options.load));
+            }
+        });
+    });
+
+    ScanResult result;
+    result.blocks_scanned = candidates.size();
+    result.blocks_skipped = index.blocks.size() - candidates.size();
+    for (vector<Document>& part : parts) {
+        move(part.begin(), part.end(), back_inserter(result.records));
+    }
+    return result;
+}
+
+}  // namespace json
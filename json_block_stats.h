@@ -0,0 +1,126 @@
+#pragma once
+
+#include "json.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Data-skipping index for NDJSON: the text is cut into blocks of whole records
+// and every block gets min/max of some numeric fields and a bloom filter of
+// some string fields, so that a scan can rule out whole blocks before parsing
+// any of their records.
+
+namespace json {
+
+    // Bit array with a fixed number of hash functions. No false negatives.
+    class BloomFilter {
+    public:
+        BloomFilter() = default;
+        // Throws std::invalid_argument unless 0 < false_positive_rate < 1
+        BloomFilter(size_t expected_items, double false_positive_rate);
+
+        void Add(std::string_view value);
+        bool MayContain(std::string_view value) const;
+
+        // Lowercase hex of the bits, for the sidecar
+        std::string ToHex() const;
+        // Throws ParsingError on bad input
+        static BloomFilter FromHex(unsigned hashes, std::string_view hex);
+
+        unsigned GetHashCount() const;
+
+    private:
+        std::vector<uint64_t> words_;
+        unsigned hashes_ = 0;
+    };
+
+    // Numbers seen at one path in one block
+    struct NumericStats {
+        uint64_t count = 0;
+        double min = 0;
+        double max = 0;
+    };
+
+    struct BlockStats {
+        // Byte range of the block in the text, always whole lines
+        uint64_t offset = 0;
+        uint64_t size = 0;
+        uint64_t records = 0;
+        // One per path of the index, in order
+        std::vector<NumericStats> numbers;
+        std::vector<BloomFilter> strings;
+    };
+
+    struct BlockStatsIndex {
+        // JSON Pointers
+        std::vector<std::string> numeric_paths;
+        std::vector<std::string> string_paths;
+        std::vector<BlockStats> blocks;
+    };
+
+    struct BlockStatsOptions {
+        std::vector<std::string> numeric_paths;
+        std::vector<std::string> string_paths;
+        // A block ends at the first line break past this many bytes
+        size_t block_size = 1 << 20;
+        double false_positive_rate = 0.01;
+        // 0 means std::thread::hardware_concurrency()
+        unsigned threads = 0;
+    };
+
+    // Reads every record once, blocks in parallel. Values of another type than
+    // expected are ignored. Throws ParsingError on malformed records and
+    // std::invalid_argument on a false_positive_rate outside (0, 1).
+    BlockStatsIndex BuildBlockStats(std::string_view text, const BlockStatsOptions& options);
+
+    // Text sidecar; numbers are written so that they read back exactly
+    void SaveBlockStats(const BlockStatsIndex& index, std::ostream& output);
+    BlockStatsIndex LoadBlockStats(std::istream& input);
+
+    // Records to keep: every condition must hold
+    struct ScanFilter {
+        struct Range {
+            std::string path;
+            // Inclusive bounds
+            double min;
+            double max;
+        };
+        struct Equals {
+            std::string path;
+            std::string value;
+        };
+
+        std::vector<Range> ranges;
+        std::vector<Equals> equals;
+    };
+
+    // Blocks that may hold a matching record. Conditions on paths the index
+    // has no statistics for don't rule out anything.
+    std::vector<size_t> CandidateBlocks(const BlockStatsIndex& index, const ScanFilter& filter);
+
+    struct ScanOptions {
+        LoadOptions load;
+        // 0 means std::thread::hardware_concurrency()
+        unsigned threads = 0;
+    };
+
+    struct ScanResult {
+        // Matching records in file order
+        std::vector<Document> records;
+        size_t blocks_scanned = 0;
+        size_t blocks_skipped = 0;
+    };
+
+    // Parses only the candidate blocks, in parallel, and checks the filter on
+    // every record of them through a projection before loading it. text must be
+    // the text the index was built from. Only the block boundaries are checked
+    // against it (std::invalid_argument when they don't cover it exactly), so
+    // a text of the same size with other contents goes unnoticed.
+    ScanResult Scan(std::string_view text, const BlockStatsIndex& index, const ScanFilter& filter,
+                    const ScanOptions& options = {});
+
+}  // namespace json
@@ -0,0 +1,256 @@
+#include "json_dedup.h"
+#include "json_detail.h"
+#include "json_workers.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <ostream>
+#include <utility>
+
+using namespace std;
+
+namespace json {
+
+namespace {
+
+const size_t kSlotsPerBucket = 4;
+// Relocations tried before an insertion gives up
+const int kMaxKicks = 500;
+// Records handed to one task of a parallel step
+const size_t kRecordsPerTask = 1024;
+// Rough cost of an entry of the exact set besides its characters: the string,
+// the hash node, the bucket pointer and allocator headers
+const size_t kEntryOverhead = sizeof(string) + 4 * sizeof(void*);
+
+// Fingerprint from the bits that don't pick the bucket, 0 marks an empty slot
+uint16_t Tag(uint64_t hash) {
+    const uint16_t tag = static_cast<uint16_t>(hash >> 48);
+    return tag == 0 ? 1 : tag;
+}
+
+}  // namespace
+
+CuckooFilter::CuckooFilter(size_t capacity) {
+    const size_t buckets = bit_ceil(max<size_t>((capacity + kSlotsPerBucket - 1) / kSlotsPerBucket, 1));
+    slots_.assign(buckets * kSlotsPerBucket, 0);
+    mask_ = buckets - 1;
+}
+
+// Partial-key cuckoo hashing: the other bucket follows from a bucket and the
+// tag alone, so tags can be moved without the hashes they came from
+size_t CuckooFilter::AltBucket(size_t bucket, uint16_t tag) const {
+    return (bucket ^ (tag * 0x5bd1e995ULL)) & mask_;
+}
+
+bool CuckooFilter::TryPlace(size_t bucket, uint16_t tag) {
+    uint16_t* slots = &slots_[bucket * kSlotsPerBucket];
+    for (size_t i = 0; i < kSlotsPerBucket; ++i) {
+        if (slots[i] == 0) {
+            slots[i] = tag;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CuckooFilter::Holds(size_t bucket, uint16_t tag) const {
+    const uint16_t* slots = &slots_[bucket * kSlotsPerBucket];
+    return slots[0] == tag || slots[1] == tag || slots[2] == tag || slots[3] == tag;
+}
+
+bool CuckooFilter::Insert(uint64_t hash) {
+    if (has_victim_) {
+        return false;
+    }
+    uint16_t tag = Tag(hash);
+    size_t bucket = hash & mask_;
+    if (TryPlace(bucket, tag) || TryPlace(AltBucket(bucket, tag), tag)) {
+        ++size_;
+        return true;
+    }
+    // Evict a tag to its other bucket, and so on
+    for (int kick = 0; kick < kMaxKicks; ++kick) {
+        swap(tag, slots_[bucket * kSlotsPerBucket + (tag + kick) % kSlotsPerBucket]);
+        bucket = AltBucket(bucket, tag);
+        if (TryPlace(bucket, tag)) {
+            ++size_;
+            return true;
+        }
+    }
+    has_victim_ = true;
+    victim_bucket_ = bucket;
+    victim_tag_ = tag;
+    ++size_;
+    return true;
+}
+
+bool CuckooFilter::MayContain(uint64_t hash) const {
+    const uint16_t tag = Tag(hash);
+    const size_t bucket = hash & mask_;
+    const size_t alt = AltBucket(bucket, tag);
+    return Holds(bucket, tag) || Holds(alt, tag)
+           || (has_victim_ && victim_tag_ == tag && (victim_bucket_ == bucket || victim_bucket_ == alt));
+}
+
+size_t CuckooFilter::Size() const {
+    return size_;
+}
+
+size_t CuckooFilter::MemoryUsage() const {
+    return slots_.size() * sizeof(uint16_t);
+}
+
+// A power of two buckets of four 16-bit tags, in half the limit
+Deduplicator::Deduplicator(const DedupOptions& options)
+    : options_(options)
+    , filter_bytes_(bit_floor(max<size_t>(options.memory_limit / 2 / (kSlotsPerBucket * sizeof(uint16_t)), 1))
+                    * kSlotsPerBucket * sizeof(uint16_t)) {
+    if (!options_.key_path.empty()) {
+        projection_.emplace(vector<string>{options_.key_path}, options_.max_depth);
+    }
+}
+
+string Deduplicator::Identity(string_view record) const {
+    string identity;
+    if (!projection_) {
+        const uint64_t hash = ContentHash(record, options_.max_depth);
+        identity.resize(sizeof(hash));
+        memcpy(identity.data(), &hash, sizeof(hash));
+        return identity;
+    }
+    const string_view key = projection_->ExtractRaw(record)[0];
+    if (!key.empty()) {
+        // Compact text of the parsed key, so that spacing and escapes in the
+        // key text don't matter
+        LoadOptions load;
+        load.max_depth = options_.max_depth;
+        detail::AppendCompact(identity, Load(key, load).GetRoot());
+    }
+    return identity;
+}
+
+bool Deduplicator::Add(string_view record) {
+    return AddIdentity(Identity(record));
+}
+
+bool Deduplicator::AddIdentity(const string& identity) {
+    ++stats_.records;
+    if (identity.empty()) {
+        ++stats_.without_key;
+        return true;
+    }
+    if (!filter_) {
+        if (!exact_.insert(identity).second) {
+            ++stats_.duplicates;
+            return false;
+        }
+        ++stats_.unique;
+        exact_bytes_ += identity.size() + kEntryOverhead;
+        if (exact_bytes_ + filter_bytes_ > options_.memory_limit) {
+            Degrade();
+        }
+        return true;
+    }
+    const uint64_t hash = detail::Hash64(identity);
+    if (filter_->MayContain(hash)) {
+        ++stats_.probable_duplicates;
+        return false;
+    }
+    if (!filter_->Insert(hash)) {
+        ++stats_.unchecked;
+        return true;
+    }
+    ++stats_.unique;
+    return true;
+}
+
+void Deduplicator::Degrade() {
+    filter_ = make_unique<CuckooFilter>(filter_bytes_ / sizeof(uint16_t));
+    for (const string& identity : exact_) {
+        filter_->Insert(detail::Hash64(identity));
+    }
+    unordered_set<string>().swap(exact_);
+    exact_bytes_ = 0;
+    stats_.degraded = true;
+}
+
+const DedupStats& Deduplicator::GetStats() const {
+    return stats_;
+}
+
+size_t Deduplicator::MemoryUsage() const {
+    return filter_ ? filter_->MemoryUsage() : exact_bytes_;
+}
+
+DedupStats DeduplicateNdjson(string_view text, const function<void(string_view)>& sink, const DedupOptions& options) {
+    Deduplicator dedup(options);
+    const unsigned threads = detail::ResolveThreads(options.threads);
+    const size_t batch_size = max<size_t>(options.batch_size, 1);
+    vector<string_view> records;
+    // Line number of every record, for errors
+    vector<size_t> lines;
+    vector<string> identities;
+    size_t pos = 0;
+    size_t line_number = 0;
+    while (pos < text.size()) {
+        const size_t line_end = text.find('\n', min(text.size(), pos + batch_size - 1));
+        const size_t end = line_end == string_view::npos ? text.size() : line_end + 1;
+        records.clear();
+        lines.clear();
+        string_view batch = text.substr(pos, end - pos);
+        while (!batch.empty()) {
+            const size_t next = batch.find('\n');
+            string_view line = batch.substr(0, next);
+            batch.remove_prefix(next == string_view::npos ? batch.size() : next + 1);
+            ++line_number;
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (!detail::IsBlankLine(line)) {
+                records.push_back(line);
+                lines.push_back(line_number);
+            }
+        }
+        pos = end;
+
+        // Every task stops at its first malformed record; the first of them is reported
+        const size_t tasks = (records.size() + kRecordsPerTask - 1) / kRecordsPerTask;
+        vector<optional<pair<size_t, string>>> errors(tasks);
+        identities.assign(records.size(), string());
+        detail::ParallelFor(tasks, threads, [&](size_t task) {
+            const size_t task_end = min(records.size(), (task + 1) * kRecordsPerTask);
+            for (size_t i = task * kRecordsPerTask; i < task_end; ++i) {
+                try {
+                    identities[i] = dedup.Identity(records[i]);
+                } catch (const ParsingError& e) {
+                    errors[task].emplace(lines[i], e.what());
+                    return;
+                }
+            }
+        });
+        for (const optional<pair<size_t, string>>& error : errors) {
+            if (error) {
+                throw ParsingError("line " + to_string(error->first) + ": " + error->second);
+            }
+        }
+        for (size_t i = 0; i < records.size(); ++i) {
+            if (dedup.AddIdentity(identities[i])) {
+                sink(records[i]);
+            }
+        }
+    }
+    return dedup.GetStats();
+}
+
+DedupStats DeduplicateNdjson(string_view text, ostream& output, const DedupOptions& options) {
+    return DeduplicateNdjson(
+        text,
+        [&output](string_view record) {
+            output.write(record.data(), record.size());
+            output.put('\n');
+        },
+        options);
+}
+
+}  // namespace json
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "json.h"
+#include "json_projection.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace json {
+
+    // Approximate set of 64-bit hashes: 16-bit fingerprints in buckets of four,
+    // every hash having two candidate buckets. No false negatives; a hash that
+    // was never inserted is reported present with a probability of about 1e-4.
+    class CuckooFilter {
+    public:
+        // Room for about capacity hashes, rounded up to a power of two buckets
+        explicit CuckooFilter(size_t capacity);
+
+        // false when the filter is full; the hash is then not inserted
+        bool Insert(uint64_t hash);
+        bool MayContain(uint64_t hash) const;
+
+        size_t Size() const;
+        size_t MemoryUsage() const;
+
+    private:
+        size_t AltBucket(size_t bucket, uint16_t tag) const;
+        bool TryPlace(size_t bucket, uint16_t tag);
+        bool Holds(size_t bucket, uint16_t tag) const;
+
+        std::vector<uint16_t> slots_;
+        size_t mask_ = 0;
+        size_t size_ = 0;
+        // Tag evicted by the last failed insertion, so that it isn't lost
+        bool has_victim_ = false;
+        size_t victim_bucket_ = 0;
+        uint16_t victim_tag_ = 0;
+    };
+
+    struct DedupOptions {
+        // JSON Pointer of the key identifying a record. Empty means the whole
+        // record, compared by ContentHash, so whitespace and member order don't
+        // matter (64 bits: distinct records collide with probability n^2 / 2^65).
+        std::string key_path;
+        // Bytes for the identities seen so far. They are kept exactly while
+        // they fit beside a CuckooFilter of up to half the limit, then moved
+        // into it, so both fit in the limit during the move.
+        size_t memory_limit = 256 << 20;
+        // Records are read in batches of about this many bytes
+        size_t batch_size = 4 << 20;
+        // 0 means std::thread::hardware_concurrency()
+        unsigned threads = 0;
+        size_t max_depth = LoadOptions{}.max_depth;
+    };
+
+    struct DedupStats {
+        uint64_t records = 0;
+        uint64_t unique = 0;
+        // Found in the exact set
+        uint64_t duplicates = 0;
+        // Found in the filter, a small share of them may be false positives
+        uint64_t probable_duplicates = 0;
+        // Kept without a check: no value at key_path
+        uint64_t without_key = 0;
+        // Kept without a check: the filter was full
+        uint64_t unchecked = 0;
+        // The exact set has been replaced by the filter
+        bool degraded = false;
+    };
+
+    // Remembers the identities of the records it is given
+    class Deduplicator {
+    public:
+        // Throws std::invalid_argument on a malformed key_path
+        explicit Deduplicator(const DedupOptions& options = {});
+
+        // Identity of a record: the compact text of its key, or its
+        // ContentHash; empty when it has no key. Works on the record text
+        // through a projection. Throws ParsingError on malformed records.
+        std::string Identity(std::string_view record) const;
+
+        // true when the record is to be kept: seen for the first time or
+        // impossible to check
+        bool Add(std::string_view record);
+        bool AddIdentity(const std::string& identity);
+
+        const DedupStats& GetStats() const;
+        size_t MemoryUsage() const;
+
+    private:
+        void Degrade();
+
+        DedupOptions options_;
+        std::optional<Projection> projection_;
+        std::unordered_set<std::string> exact_;
+        size_t exact_bytes_ = 0;
+        // Size of the filter the exact set turns into
+        size_t filter_bytes_ = 0;
+        std::unique_ptr<CuckooFilter> filter_;
+        DedupStats stats_;
+    };
+
+    // Calls sink for the first occurrence of every record of an NDJSON text,
+    // in order, without its line break; blank lines are skipped. Identities
+    // are computed on several threads a batch at a time; only the set lookups
+    // are serial. Throws ParsingError with the line number of a malformed
+    // record.
+    DedupStats DeduplicateNdjson(std::string_view text, const std::function<void(std::string_view)>& sink,
+                                 const DedupOptions& options = {});
+
+    // Same, writing the kept records as NDJSON
+    DedupStats DeduplicateNdjson(std::string_view text, std::ostream& output, const DedupOptions& options = {});
+
+}  // namespace json
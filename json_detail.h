@@ -0,0 +1,299 @@
+#pragma once
+
+#include "json.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <optional>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Helpers shared by the different printers and parsers (stream, scatter, ...).
+// Not part of the public interface.
+
+namespace json::detail {
+
+    // Returns the escape sequence for c, or nullptr when c is printed as is.
+    inline const char* EscapeSequence(char c) {
+        switch (c) {
+            case '\n': return "\\n";
+            case '\r': return "\\r";
+            case '\t': return "\\t";
+            case '"': return "\\\"";
+            case '\\': return "\\\\";
+            default: return nullptr;
+        }
+    }
+
+    // Character denoted by the escape sequence "\\c"
+    inline char Unescape(char c) {
+        switch (c) {
+            case 'n': return '\n';
+            case 'r': return '\r';
+            case 't': return '\t';
+            case '"': return '"';
+            case '\\': return '\\';
+            default: throw ParsingError("Invalid escape sequence");
+        }
+    }
+
+    // For a valid number token out of the range of double: true when it is too
+    // close to zero (underflow) rather than too big. Looks at the decimal
+    // exponent of its first significant digit.
+    inline bool IsTinyNumber(std::string_view text) {
+        size_t pos = !text.empty() && text[0] == '-' ? 1 : 0;
+        long long exponent = -1;
+        bool significant = false;
+        for (; pos < text.size() && std::isdigit(static_cast<unsigned char>(text[pos])); ++pos) {
+            significant = significant || text[pos] != '0';
+            exponent += significant ? 1 : 0;
+        }
+        if (pos < text.size() && text[pos] == '.') {
+            for (++pos; pos < text.size() && std::isdigit(static_cast<unsigned char>(text[pos])); ++pos) {
+                if (!significant) {
+                    significant = text[pos] != '0';
+                    --exponent;
+                }
+            }
+        }
+        if (!significant) {
+            return true;
+        }
+        if (pos < text.size() && (text[pos] == 'e' || text[pos] == 'E')) {
+            ++pos;
+            const bool negative = pos < text.size() && text[pos] == '-';
+            pos += pos < text.size() && (text[pos] == '-' || text[pos] == '+') ? 1 : 0;
+            long long value = 0;
+            for (; pos < text.size(); ++pos) {
+                value = std::min(value * 10 + (text[pos] - '0'), 1'000'000'000LL);
+            }
+            exponent += negative ? -value : value;
+        }
+        return exponent < 0;
+    }
+
+    // Converts the characters of a number token. Integers that don't fit into
+    // int are kept as double; numbers too close to zero for a double become
+    // a zero of their sign.
+    inline Node NumberFromText(std::string_view text, bool is_double) {
+        const char* first = text.data();
+        const char* last = first + text.size();
+        if (!is_double) {
+            int num;
+            auto [ptr, ec] = std::from_chars(first, last, num);
+            if (ec == std::errc{} && ptr == last) {
+                return Node(num);
+            }
+            if (ec != std::errc::result_out_of_range) {
+                throw ParsingError("Invalid number: " + std::string(text));
+            }
+        }
+        double num;
+        auto [ptr, ec] = std::from_chars(first, last, num);
+        if (ec == std::errc::result_out_of_range) {
+            if (ptr != last || !IsTinyNumber(text)) {
+                throw ParsingError("Number out of range: " + std::string(text));
+            }
+            return Node(text[0] == '-' ? -0.0 : 0.0);
+        }
+        if (ec != std::errc{} || ptr != last) {
+            throw ParsingError("Invalid number: " + std::string(text));
+        }
+        return Node(num);
+    }
+
+    // Same text as `output << value` with default stream flags, plus ".0" for integral values
+    inline void AppendDouble(std::string& out, double value) {
+        char buf[32];
+        int len = std::snprintf(buf, sizeof(buf), "%g", value);
+        out.append(buf, len);
+        if (std::floor(value) == value && std::abs(value) < 1e10) {
+            out += ".0";
+        }
+    }
+
+    inline void AppendInt(std::string& out, int value) {
+        char buf[16];
+        int len = std::snprintf(buf, sizeof(buf), "%d", value);
+        out.append(buf, len);
+    }
+
+    inline void AppendString(std::string& out, std::string_view value) {
+        out += '"';
+        for (char c : value) {
+            if (const char* escaped = EscapeSequence(c)) {
+                out += escaped;
+            } else {
+                out += c;
+            }
+        }
+        out += '"';
+    }
+
+    // Single line without whitespace, the form of an NDJSON record
+    inline void AppendCompact(std::string& out, const Node& node) {
+        if (node.IsNull()) {
+            out += "null";
+        } else if (node.IsBool()) {
+            out += node.AsBool() ? "true" : "false";
+        } else if (node.IsInt()) {
+            AppendInt(out, node.AsInt());
+        } else if (node.IsPureDouble()) {
+            AppendDouble(out, node.AsDouble());
+        } else if (node.IsString()) {
+            AppendString(out, node.AsString());
+        } else if (node.IsArray()) {
+            out += '[';
+            bool first = true;
+            for (const Node& item : node.AsArray()) {
+                if (!first) {
+                    out += ',';
+                }
+                first = false;
+                AppendCompact(out, item);
+            }
+            out += ']';
+        } else {
+            out += '{';
+            bool first = true;
+            for (const auto& [key, value] : node.AsMap()) {
+                if (!first) {
+                    out += ',';
+                }
+                first = false;
+                AppendString(out, key);
+                out += ':';
+                AppendCompact(out, value);
+            }
+            out += '}';
+        }
+    }
+
+    // 64-bit hash that is the same on every platform and run, so it can be
+    // stored in files: FNV-1a with a final mix to spread the low-entropy bits
+    inline uint64_t Hash64(std::string_view bytes, uint64_t seed = 0) {
+        uint64_t hash = 0xcbf29ce484222325ULL ^ seed;
+        for (char c : bytes) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+        }
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53ULL;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    // Whether an NDJSON line holds no record: empty or JSON whitespace only
+    inline bool IsBlankLine(std::string_view line) {
+        return line.find_first_not_of(" \t\r") == std::string_view::npos;
+    }
+
+    // Calls fn for every line of NDJSON text that isn't blank, without its line
+    // break
+    template <typename Fn>
+    void ForEachRecord(std::string_view text, Fn fn) {
+        while (!text.empty()) {
+            size_t end = text.find('\n');
+            std::string_view line = text.substr(0, end);
+            text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (!IsBlankLine(line)) {
+                fn(line);
+            }
+        }
+    }
+
+    // Parses the string values at options.embedded_json_paths into the table of
+    // doc (defined with the parser)
+    JSON_INLINE void ExpandEmbeddedPaths(const Document& doc, const LoadOptions& options);
+
+    // Splits a JSON Pointer into unescaped reference tokens
+    inline std::vector<std::string> SplitPointer(std::string_view pointer) {
+        std::vector<std::string> tokens;
+        if (pointer.empty()) {
+            return tokens;
+        }
+        if (pointer.front() != '/') {
+            throw std::invalid_argument("JSON Pointer should start with /: " + std::string(pointer));
+        }
+        for (size_t pos = 1;;) {
+            size_t end = pointer.find('/', pos);
+            std::string token(pointer.substr(pos, end == std::string_view::npos ? std::string_view::npos : end - pos));
+            for (size_t i = 0; (i = token.find('~', i)) != std::string::npos; ++i) {
+                if (i + 1 < token.size() && (token[i + 1] == '0' || token[i + 1] == '1')) {
+                    token.replace(i, 2, token[i + 1] == '0' ? "~" : "/");
+                } else {
+                    throw std::invalid_argument("Invalid escape in JSON Pointer: " + std::string(pointer));
+                }
+            }
+            tokens.push_back(std::move(token));
+            if (end == std::string_view::npos) {
+                break;
+            }
+            pos = end + 1;
+        }
+        return tokens;
+    }
+
+    // Appends "/" and the escaped token, the inverse of SplitPointer
+    inline void AppendPointerToken(std::string& pointer, std::string_view token) {
+        pointer += '/';
+        for (char c : token) {
+            if (c == '~') {
+                pointer += "~0";
+            } else if (c == '/') {
+                pointer += "~1";
+            } else {
+                pointer += c;
+            }
+        }
+    }
+
+    // Array index denoted by a pointer token. RFC 6901 allows no leading
+    // zeros, so "03" is not an index (it could only be a dict key).
+    inline std::optional<size_t> IndexToken(std::string_view token) {
+        if (token.empty() || token.size() >= 10 || (token.size() > 1 && token[0] == '0')
+            || !std::all_of(token.begin(), token.end(), [](unsigned char c) { return std::isdigit(c); })) {
+            return std::nullopt;
+        }
+        size_t index = 0;
+        std::from_chars(token.data(), token.data() + token.size(), index);
+        return index;
+    }
+
+    // Dict member or array element referenced by a pointer token, nullptr if absent
+    inline const Node* FindChild(const Node& node, const std::string& token) {
+        if (node.IsMap()) {
+            const Dict& dict = node.AsMap();
+            auto it = dict.find(token);
+            return it == dict.end() ? nullptr : &it->second;
+        }
+        if (node.IsArray()) {
+            const Array& array = node.AsArray();
+            const std::optional<size_t> index = IndexToken(token);
+            return index && *index < array.size() ? &array[*index] : nullptr;
+        }
+        return nullptr;
+    }
+
+    inline const Node* FindPointer(const Node& root, const std::vector<std::string>& tokens) {
+        const Node* node = &root;
+        for (const std::string& token : tokens) {
+            if (node = FindChild(*node, token); node == nullptr) {
+                break;
+            }
+        }
+        return node;
+    }
+
+}  // namespace json::detail
@@ -0,0 +1,282 @@
+#include "json_diff.h"
+#include "json_detail.h"
+#include "json_projection.h"
+#include "json_workers.h"
+
+#include <algorithm>
+#include <optional>
+#include <ostream>
+#include <vector>
+
+using namespace std;
+
+namespace json {
+
+namespace {
+
+// Records handed to one task of a parallel step
+const size_t kRecordsPerTask = 1024;
+
+Node Operation(string_view op, const string& path) {
+    return Node(Dict{{"op"s, Node(string(op))}, {"path"s, Node(path)}});
+}
+
+Node Operation(string_view op, const string& path, const Node& value) {
+    return Node(Dict{{"op"s, Node(string(op))}, {"path"s, Node(path)}, {"value"s, value}});
+}
+
+void Diff(const Node& from, const Node& to, string& path, Array& ops) {
+    if (from == to) {
+        return;
+    }
+    const size_t path_size = path.size();
+    if (from.IsMap() && to.IsMap()) {
+        const Dict& old_dict = from.AsMap();
+        const Dict& new_dict = to.AsMap();
+        for (const auto& [key, value] : old_dict) {
+            detail::AppendPointerToken(path, key);
+            if (auto it = new_dict.find(key); it == new_dict.end()) {
+                ops.push_back(Operation("remove"sv, path));
+            } else {
+                Diff(value, it->second, path, ops);
+            }
+            path.resize(path_size);
+        }
+        for (const auto& [key, value] : new_dict) {
+            if (old_dict.count(key) == 0) {
+                detail::AppendPointerToken(path, key);
+                ops.push_back(Operation("add"sv, path, value));
+                path.resize(path_size);
+            }
+        }
+    } else if (from.IsArray() && to.IsArray()) {
+        const Array& old_array = from.AsArray();
+        const Array& new_array = to.AsArray();
+        const size_t common = min(old_array.size(), new_array.size());
+        for (size_t i = 0; i < common; ++i) {
+            detail::AppendPointerToken(path, to_string(i));
+            Diff(old_array[i], new_array[i], path, ops);
+            path.resize(path_size);
+        }
+        for (size_t i = common; i < new_array.size(); ++i) {
+            detail::AppendPointerToken(path, to_string(i));
+            ops.push_back(Operation("add"sv, path, new_array[i]));
+            path.resize(path_size);
+        }
+        // From the end, so that earlier removals don't shift later ones
+        for (size_t i = old_array.size(); i-- > common;) {
+            detail::AppendPointerToken(path, to_string(i));
+            ops.push_back(Operation("remove"sv, path));
+            path.resize(path_size);
+        }
+    } else {
+        ops.push_back(Operation("replace"sv, path, to));
+    }
+}
+
+// Numbers before strings, numbers by value, strings by bytes
+bool KeyLess(const Node& lhs, const Node& rhs) {
+    if (lhs.IsString() != rhs.IsString()) {
+        return rhs.IsString();
+    }
+    return lhs.IsString() ? lhs.AsString() < rhs.AsString() : lhs.AsDouble() < rhs.AsDouble();
+}
+
+// Unread records of one side, a batch of them with their keys
+class Side {
+public:
+    Side(string_view text, string_view name)
+        : text_(text)
+        , name_(name) {
+    }
+
+    // Drops the merged records and reads more, up to batch_size bytes
+    void Refill(size_t batch_size, const Projection& projection, unsigned threads) {
+        if (next_ > 0) {
+            last_key_ = std::move(keys_[next_ - 1]);
+            lines_.erase(lines_.begin(), lines_.begin() + next_);
+            keys_.erase(keys_.begin(), keys_.begin() + next_);
+            next_ = 0;
+        }
+        size_t bytes = 0;
+        for (const string_view& line : lines_) {
+            bytes += line.size();
+        }
+        const size_t first_new = lines_.size();
+        while (pos_ < text_.size() && (bytes < batch_size || lines_.empty())) {
+            const size_t end = text_.find('\n', pos_);
+            string_view line = text_.substr(pos_, end == string_view::npos ? string_view::npos : end - pos_);
+            pos_ = end == string_view::npos ? text_.size() : end + 1;
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (!detail::IsBlankLine(line)) {
+                lines_.push_back(line);
+                bytes += line.size();
+            }
+        }
+
+        keys_.resize(lines_.size());
+        const size_t count = lines_.size() - first_new;
+        detail::ParallelFor((count + kRecordsPerTask - 1) / kRecordsPerTask, threads, [&](size_t task) {
+            vector<string_view> values;
+            const size_t end = min(count, (task + 1) * kRecordsPerTask);
+            for (size_t i = first_new + task * kRecordsPerTask; i < first_new + end; ++i) {
+                projection.ExtractRaw(lines_[i], values);
+                if (values[0].empty()) {
+                    throw ParsingError("Record without a key in "s + string(name_));
+                }
+                Node key = Load(values[0]).GetRoot();
+                if (!key.IsDouble() && !key.IsString()) {
+                    throw ParsingError("Key is neither a number nor a string in "s + string(name_));
+                }
+                keys_[i] = std::move(key);
+            }
+        });
+        for (size_t i = first_new; i < lines_.size(); ++i) {
+            const Node* previous = i > 0 ? &keys_[i - 1] : last_key_ ? &*last_key_ : nullptr;
+            if (previous != nullptr && !KeyLess(*previous, keys_[i])) {
+                throw ParsingError("Records of "s + string(name_) + " are not sorted by unique keys");
+            }
+        }
+    }
+
+    bool HasRecord() const {
+        return next_ < lines_.size();
+    }
+
+    // No record left in the batch, but more in the text
+    bool NeedsRefill() const {
+        return !HasRecord() && pos_ < text_.size();
+    }
+
+    string_view Line() const {
+        return lines_[next_];
+    }
+
+    const Node& Key() const {
+        return keys_[next_];
+    }
+
+    void Advance() {
+        ++next_;
+    }
+
+private:
+    string_view text_;
+    string_view name_;
+    size_t pos_ = 0;
+    vector<string_view> lines_;
+    vector<Node> keys_;
+    size_t next_ = 0;
+    optional<Node> last_key_;
+};
+
+struct Pair {
+    string_view from;
+    string_view to;
+    const Node* key;
+};
+
+}  // namespace
+
+Node DiffNodes(const Node& from, const Node& to) {
+    Array ops;
+    string path;
+    Diff(from, to, path, ops);
+    return Node(std::move(ops));
+}
+
+DiffStats DiffSortedNdjson(string_view from, string_view to, const function<void(const RecordDiff&)>& sink,
+                           const DiffOptions& options) {
+    const Projection projection({options.key_path});
+    const unsigned threads = detail::ResolveThreads(options.threads);
+    Side old_side(from, "the old text"sv);
+    Side new_side(to, "the new text"sv);
+    DiffStats stats;
+
+    while (true) {
+        old_side.Refill(options.batch_size, projection, threads);
+        new_side.Refill(options.batch_size, projection, threads);
+        if (!old_side.HasRecord() && !new_side.HasRecord()) {
+            break;
+        }
+
+        // Merge until a batch runs out while its text goes on
+        vector<Pair> pairs;
+        while (!old_side.NeedsRefill() && !new_side.NeedsRefill()
+               && (old_side.HasRecord() || new_side.HasRecord())) {
+            if (!new_side.HasRecord() || (old_side.HasRecord() && KeyLess(old_side.Key(), new_side.Key()))) {
+                pairs.push_back({old_side.Line(), {}, &old_side.Key()});
+                old_side.Advance();
+            } else if (!old_side.HasRecord() || KeyLess(new_side.Key(), old_side.Key())) {
+                pairs.push_back({{}, new_side.Line(), &new_side.Key()});
+                new_side.Advance();
+            } else {
+                pairs.push_back({old_side.Line(), new_side.Line(), &old_side.Key()});
+                old_side.Advance();
+                new_side.Advance();
+            }
+        }
+
+        vector<optional<RecordDiff>> diffs(pairs.size());
+        detail::ParallelFor((pairs.size() + kRecordsPerTask - 1) / kRecordsPerTask, threads, [&](size_t task) {
+            const size_t end = min(pairs.size(), (task + 1) * kRecordsPerTask);
+            for (size_t i = task * kRecordsPerTask; i < end; ++i) {
+                const Pair& pair = pairs[i];
+                if (pair.to.empty()) {
+                    diffs[i] = RecordDiff{RecordDiff::Kind::kRemoved, *pair.key, Node(Array{Operation("remove"sv, ""s)})};
+                } else if (pair.from.empty()) {
+                    diffs[i] = RecordDiff{RecordDiff::Kind::kAdded, *pair.key,
+                                          Node(Array{Operation("add"sv, ""s, Load(pair.to, options.load).GetRoot())})};
+                } else if (pair.from != pair.to) {
+                    // The hashes see every duplicate key, Load keeps the first
+                    // one: with duplicates only the Nodes tell
+                    bool duplicate_keys = false;
+                    const uint64_t old_hash = ContentHash(pair.from, options.load.max_depth, duplicate_keys);
+                    const uint64_t new_hash = ContentHash(pair.to, options.load.max_depth, duplicate_keys);
+                    if (old_hash == new_hash && !duplicate_keys) {
+                        continue;
+                    }
+                    Node patch = DiffNodes(Load(pair.from, options.load).GetRoot(),
+                                           Load(pair.to, options.load).GetRoot());
+                    if (!patch.AsArray().empty()) {
+                        diffs[i] = RecordDiff{RecordDiff::Kind::kChanged, *pair.key, std::move(patch)};
+                    }
+                }
+            }
+        });
+
+        for (const optional<RecordDiff>& diff : diffs) {
+            if (!diff) {
+                ++stats.unchanged;
+                continue;
+            }
+            switch (diff->kind) {
+                case RecordDiff::Kind::kAdded: ++stats.added; break;
+                case RecordDiff::Kind::kRemoved: ++stats.removed; break;
+                case RecordDiff::Kind::kChanged: ++stats.changed; break;
+            }
+            sink(*diff);
+        }
+    }
+    return stats;
+}
+
+DiffStats DiffSortedNdjson(string_view from, string_view to, ostream& output, const DiffOptions& options) {
+    string line;
+    return DiffSortedNdjson(
+        from, to,
+        [&output, &line](const RecordDiff& diff) {
+            static const char* const kNames[] = {"added", "removed", "changed"};
+            line.clear();
+            detail::AppendCompact(line, Node(Dict{{"key"s, diff.key},
+                                                  {"op"s, Node(string(kNames[static_cast<int>(diff.kind)]))},
+                                                  {"patch"s, diff.patch}}));
+            line += '\n';
+            output.write(line.data(), line.size());
+        },
+        options);
+}
+
+}  // namespace json
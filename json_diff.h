@@ -0,0 +1,62 @@
+#pragma once
+
+#include "json.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+
+namespace json {
+
+    // JSON Patch (RFC 6902) turning from into to: an array of add, remove and
+    // replace operations, applied in order. Arrays are compared by position.
+    Node DiffNodes(const Node& from, const Node& to);
+
+    struct RecordDiff {
+        enum class Kind { kAdded, kRemoved, kChanged };
+
+        Kind kind;
+        Node key;
+        // For kAdded a single add of the whole record, for kRemoved a single
+        // remove, for kChanged the operations of DiffNodes
+        Node patch;
+    };
+
+    struct DiffStats {
+        uint64_t added = 0;
+        uint64_t removed = 0;
+        uint64_t changed = 0;
+        uint64_t unchanged = 0;
+    };
+
+    struct DiffOptions {
+        // JSON Pointer of the key the files are sorted by: ascending numbers
+        // first, then strings in byte order
+        std::string key_path = "/id";
+        // Records are read in batches of about this many bytes from each side,
+        // which bounds memory
+        size_t batch_size = 4 << 20;
+        // 0 means std::thread::hardware_concurrency()
+        unsigned threads = 0;
+        LoadOptions load;
+    };
+
+    // Merges two NDJSON texts (e.g. mapped exports) sorted by the key and calls
+    // sink for every added, removed and changed record in key order. Keys are
+    // found through a projection; records that differ byte-wise are compared by
+    // ContentHash first, and only those whose hashes differ or that repeat a
+    // key are parsed and diffed. Throws ParsingError on a record without a
+    // number or string key, on keys out of order or repeated, and on malformed
+    // records.
+    DiffStats DiffSortedNdjson(std::string_view from, std::string_view to,
+                               const std::function<void(const RecordDiff&)>& sink, const DiffOptions& options = {});
+
+    // Same, writing one line per difference:
+    // {"key": ..., "op": "added"|"removed"|"changed", "patch": [...]}
+    DiffStats DiffSortedNdjson(std::string_view from, std::string_view to, std::ostream& output,
+                               const DiffOptions& options = {});
+
+}  // namespace json
@@ -0,0 +1,522 @@
+#pragma once
+
+// Definitions for json.h. Compiled once by json.cpp, or included into every
+// translation unit by json.h when JSON_HEADER_ONLY is defined, which makes the
+// accessors, the parser and the printer available for inlining.
+
+#include "json.h"
+#include "json_detail.h"
+#include "json_probes.h"
+#include "json_tokenizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <utility>
+
+namespace json {
+
+JSON_INLINE Node::Node(std::nullptr_t) : value_(nullptr) {}
+JSON_INLINE Node::Node(Array array) : value_(std::move(array)) {}
+JSON_INLINE Node::Node(Dict map) : value_(std::move(map)) {}
+JSON_INLINE Node::Node(bool value) : value_(value) {}
+JSON_INLINE Node::Node(int value) : value_(value) {}
+JSON_INLINE Node::Node(double value) : value_(value) {}
+JSON_INLINE Node::Node(const char* value) : value_(std::string(value)) {}
+JSON_INLINE Node::Node(std::string value) : value_(std::move(value)) {}
+
+// Non-explicit constructors for implicit conversions
+JSON_INLINE Node::Node(int value, bool /*is_explicit*/) : value_(value) {}
+JSON_INLINE Node::Node(double value, bool /*is_explicit*/) : value_(value) {}
+JSON_INLINE Node::Node(const char* value, bool /*is_explicit*/) : value_(std::string(value)) {}
+JSON_INLINE Node::Node(std::string value, bool /*is_explicit*/) : value_(std::move(value)) {}
+
+JSON_INLINE bool Node::IsNull() const { return std::holds_alternative<std::nullptr_t>(value_); }
+JSON_INLINE bool Node::IsArray() const { return std::holds_alternative<Array>(value_); }
+JSON_INLINE bool Node::IsMap() const { return std::holds_alternative<Dict>(value_); }
+JSON_INLINE bool Node::IsBool() const { return std::holds_alternative<bool>(value_); }
+JSON_INLINE bool Node::IsInt() const { return std::holds_alternative<int>(value_); }
+JSON_INLINE bool Node::IsDouble() const { return std::holds_alternative<double>(value_) || IsInt(); }
+JSON_INLINE bool Node::IsPureDouble() const { return std::holds_alternative<double>(value_); }
+JSON_INLINE bool Node::IsString() const { return std::holds_alternative<std::string>(value_); }
+
+JSON_INLINE const Array& Node::AsArray() const {
+    if (!IsArray()) throw std::logic_error("Not an array");
+    return std::get<Array>(value_);
+}
+
+JSON_INLINE const Dict& Node::AsMap() const {
+    if (!IsMap()) throw std::logic_error("Not a map");
+    return std::get<Dict>(value_);
+}
+
+JSON_INLINE bool Node::AsBool() const {
+    if (!IsBool()) throw std::logic_error("Not a bool");
+    return std::get<bool>(value_);
+}
+
+JSON_INLINE int Node::AsInt() const {
+    if (!IsInt()) throw std::logic_error("Not an int");
+    return std::get<int>(value_);
+}
+
+JSON_INLINE double Node::AsDouble() const {
+    if (IsInt()) return std::get<int>(value_);
+    if (!IsDouble()) throw std::logic_error("Not a double");
+    return std::get<double>(value_);
+}
+
+JSON_INLINE const std::string& Node::AsString() const {
+    if (!IsString()) throw std::logic_error("Not a string");
+    return std::get<std::string>(value_);
+}
+
+JSON_INLINE bool Node::operator==(const Node& rhs) const {
+    return value_ == rhs.value_;
+}
+
+JSON_INLINE bool Node::operator!=(const Node& rhs) const {
+    return !(*this == rhs);
+}
+
+JSON_INLINE bool Node::operator==(const Array& arr) const {
+    return IsArray() && AsArray() == arr;
+}
+
+JSON_INLINE bool Node::operator==(const Dict& dict) const {
+    return IsMap() && AsMap() == dict;
+}
+
+JSON_INLINE Document::Document(Node root) : root_(std::move(root)) {}
+JSON_INLINE Document::Document(Array array) : root_(Node(std::move(array))) {}
+JSON_INLINE Document::Document(Dict dict) : root_(Node(std::move(dict))) {}
+
+// The table is keyed by Node addresses, which a copy doesn't share. A move
+// keeps every address but the one of the root.
+JSON_INLINE Document::Document(const Document& other) : root_(other.root_) {}
+
+JSON_INLINE Document::Document(Document&& other) noexcept : root_(std::move(other.root_)) {
+    TakeEmbedded(other);
+}
+
+JSON_INLINE Document& Document::operator=(const Document& other) {
+    if (this != &other) {
+        *this = Document(other);
+    }
+    return *this;
+}
+
+JSON_INLINE Document& Document::operator=(Document&& other) noexcept {
+    if (this != &other) {
+        root_ = std::move(other.root_);
+        TakeEmbedded(other);
+    }
+    return *this;
+}
+
+JSON_INLINE Document::~Document() {
+    delete embedded_.load();
+}
+
+JSON_INLINE const Node& Document::GetRoot() const {
+    return root_;
+}
+
+JSON_INLINE detail::EmbeddedTable& Document::GetEmbeddedTable() const {
+    detail::EmbeddedTable* table = embedded_.load(std::memory_order_acquire);
+    if (table == nullptr) {
+        auto created = std::make_unique<detail::EmbeddedTable>();
+        if (embedded_.compare_exchange_strong(table, created.get(), std::memory_order_acq_rel)) {
+            table = created.release();
+        }
+    }
+    return *table;
+}
+
+// Takes the table of other, whose root has just moved to root_
+JSON_INLINE void Document::TakeEmbedded(Document& other) {
+    delete embedded_.exchange(other.embedded_.exchange(nullptr));
+    if (detail::EmbeddedTable* table = embedded_.load()) {
+        if (auto entry = table->documents.extract(&other.root_)) {
+            entry.key() = &root_;
+            table->documents.insert(std::move(entry));
+        }
+    }
+}
+
+JSON_INLINE void Document::ClearEmbedded() {
+    delete embedded_.exchange(nullptr);
+}
+
+JSON_INLINE Node* Document::FindParent(const std::vector<std::string>& tokens, std::string_view pointer) {
+    const Node* parent = &root_;
+    for (size_t i = 0; i + 1 < tokens.size() && parent != nullptr; ++i) {
+        parent = detail::FindChild(*parent, tokens[i]);
+    }
+    if (parent == nullptr || !(parent->IsMap() || parent->IsArray())) {
+        throw std::out_of_range("No container at the parent of " + std::string(pointer));
+    }
+    return const_cast<Node*>(parent);
+}
+
+JSON_INLINE std::optional<Node> Document::Set(std::string_view pointer, Node value) {
+    ClearEmbedded();
+    const std::vector<std::string> tokens = detail::SplitPointer(pointer);
+    if (tokens.empty()) {
+        return std::exchange(root_, std::move(value));
+    }
+
+    Node* parent = FindParent(tokens, pointer);
+    const std::string& token = tokens.back();
+    if (parent->IsMap()) {
+        auto [it, inserted] = std::get<Dict>(parent->value_).try_emplace(token);
+        std::optional<Node> old;
+        if (!inserted) {
+            old = std::move(it->second);
+        }
+        it->second = std::move(value);
+        return old;
+    }
+
+    Array& array = std::get<Array>(parent->value_);
+    if (token == "-" || token == std::to_string(array.size())) {
+        array.push_back(std::move(value));
+        return std::nullopt;
+    }
+    Node* element = const_cast<Node*>(detail::FindChild(*parent, token));
+    if (element == nullptr) {
+        throw std::out_of_range("Array index out of range: " + std::string(pointer));
+    }
+    return std::exchange(*element, std::move(value));
+}
+
+JSON_INLINE std::optional<Node> Document::Erase(std::string_view pointer) {
+    ClearEmbedded();
+    const std::vector<std::string> tokens = detail::SplitPointer(pointer);
+    if (tokens.empty()) {
+        return std::exchange(root_, Node{});
+    }
+
+    const Node* parent = &root_;
+    for (size_t i = 0; i + 1 < tokens.size() && parent != nullptr; ++i) {
+        parent = detail::FindChild(*parent, tokens[i]);
+    }
+    const Node* child = parent ? detail::FindChild(*parent, tokens.back()) : nullptr;
+    if (child == nullptr) {
+        return std::nullopt;
+    }
+
+    Node* mutable_parent = const_cast<Node*>(parent);
+    std::optional<Node> old = std::move(*const_cast<Node*>(child));
+    if (mutable_parent->IsMap()) {
+        std::get<Dict>(mutable_parent->value_).erase(tokens.back());
+    } else {
+        Array& array = std::get<Array>(mutable_parent->value_);
+        array.erase(array.begin() + (child - array.data()));
+    }
+    return old;
+}
+
+namespace detail {
+
+template <typename Source>
+Node LoadNode(Source& src, size_t depth_left);
+
+template <typename Source>
+Node LoadArray(Source& src, size_t depth_left) {
+    Array result;
+
+    if (src.Get() != '[') {
+        throw ParsingError("Array should start with [");
+    }
+    if (depth_left == 0) {
+        throw ParsingError("Nesting is too deep");
+    }
+
+    src.SkipWhitespace();
+    if (src.Peek() == ']') {
+        src.Get();
+        return Node(std::move(result));
+    }
+
+    while (true) {
+        src.SkipWhitespace();
+        result.push_back(LoadNode(src, depth_left - 1));
+        src.SkipWhitespace();
+
+        int c = src.Get();
+        if (c == ']') {
+            break;
+        } else if (c != ',') {
+            throw ParsingError("Expected ',' or ']' in array");
+        }
+    }
+
+    return Node(std::move(result));
+}
+
+template <typename Source>
+Node LoadDict(Source& src, size_t depth_left) {
+    Dict result;
+
+    if (src.Get() != '{') {
+        throw ParsingError("Dict should start with {");
+    }
+    if (depth_left == 0) {
+        throw ParsingError("Nesting is too deep");
+    }
+
+    src.SkipWhitespace();
+    if (src.Peek() == '}') {
+        src.Get();
+        return Node(std::move(result));
+    }
+
+    while (true) {
+        src.SkipWhitespace();
+        if (src.Get() != '"') {
+            throw ParsingError("Dict key should start with \"");
+        }
+
+        std::string key = ReadString(src);
+        src.SkipWhitespace();
+
+        if (src.Get() != ':') {
+            throw ParsingError("Expected ':' after dict key");
+        }
+
+        src.SkipWhitespace();
+        result.emplace(std::move(key), LoadNode(src, depth_left - 1));
+        src.SkipWhitespace();
+
+        int c = src.Get();
+        if (c == '}') {
+            break;
+        } else if (c != ',') {
+            throw ParsingError("Expected ',' or '}' in dict");
+        }
+    }
+
+    return Node(std::move(result));
+}
+
+template <typename Source>
+Node LoadNode(Source& src, size_t depth_left) {
+    TraceLoadedNode(depth_left);
+    src.SkipWhitespace();
+    const int c = src.Peek();
+
+    if (c == Source::kEof) {
+        throw ParsingError("Unexpected end of input");
+    } else if (c == '[') {
+        return LoadArray(src, depth_left);
+    } else if (c == '{') {
+        return LoadDict(src, depth_left);
+    } else if (c == '"') {
+        src.Get();
+        return Node(ReadString(src));
+    } else if (HasClass(c, kDigit) || c == '-') {
+        return ReadNumber(src);
+    } else if (HasClass(c, kAlpha)) {
+        return ReadLiteral(src);
+    } else {
+        throw ParsingError("Unexpected character: " + std::string(1, static_cast<char>(c)));
+    }
+}
+
+JSON_INLINE Node LoadNode(std::istream& input, size_t depth_left) {
+    std::istream::sentry sentry(input, true);
+    if (!sentry) {
+        throw ParsingError("Unexpected end of input");
+    }
+    StreamSource src(input.rdbuf());
+    Node result = LoadNode(src, depth_left);
+    if (src.SeenEof()) {
+        input.setstate(std::ios_base::eofbit);
+    }
+    return result;
+}
+
+JSON_INLINE Node LoadNode(std::string_view text, size_t depth_left) {
+    BufferSource src(text.data(), text.data() + text.size());
+    return LoadNode(src, depth_left);
+}
+
+JSON_INLINE void PrintNode(const Node& node, std::ostream& output, int indent = 0);
+
+JSON_INLINE void PrintString(const std::string& value, std::ostream& output) {
+    output << '"';
+    for (char c : value) {
+        if (const char* escaped = detail::EscapeSequence(c)) {
+            output << escaped;
+        } else {
+            output << c;
+        }
+    }
+    output << '"';
+}
+
+JSON_INLINE void PrintArray(const Array& array, std::ostream& output, int indent) {
+    output << '[';
+    bool first = true;
+    for (const auto& node : array) {
+        if (!first) {
+            output << ',';
+        }
+        first = false;
+        output << '\n' << std::string(indent + 2, ' ');
+        PrintNode(node, output, indent + 2);
+    }
+    if (!array.empty()) {
+        output << '\n' << std::string(indent, ' ');
+    }
+    output << ']';
+}
+
+JSON_INLINE void PrintDict(const Dict& dict, std::ostream& output, int indent) {
+    output << '{';
+    bool first = true;
+    for (const auto& [key, node] : dict) {
+        if (!first) {
+            output << ',';
+        }
+        first = false;
+        output << '\n' << std::string(indent + 2, ' ');
+        PrintString(key, output);
+        output << ": ";
+        PrintNode(node, output, indent + 2);
+    }
+    if (!dict.empty()) {
+        output << '\n' << std::string(indent, ' ');
+    }
+    output << '}';
+}
+
+JSON_INLINE void PrintNode(const Node& node, std::ostream& output, int indent) {
+    TraceNode(indent / 2);
+    std::visit([&output, indent](const auto& value) {
+        using T = std::decay_t<decltype(value)>;
+
+        if constexpr (std::is_same_v<T, std::nullptr_t>) {
+            output << "null";
+        } else if constexpr (std::is_same_v<T, bool>) {
+            output << (value ? "true" : "false");
+        } else if constexpr (std::is_same_v<T, int>) {
+            output << value;
+        } else if constexpr (std::is_same_v<T, double>) {
+            output << value;
+            if (std::floor(value) == value && std::abs(value) < 1e10) {
+                output << ".0";
+            }
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            PrintString(value, output);
+        } else if constexpr (std::is_same_v<T, Array>) {
+            PrintArray(value, output, indent);
+        } else if constexpr (std::is_same_v<T, Dict>) {
+            PrintDict(value, output, indent);
+        }
+    }, node.GetValue());
+}
+
+JSON_INLINE void ExpandEmbedded(const Document& doc, const Node& node, const std::vector<std::string>& tokens,
+                                size_t depth) {
+    if (depth == tokens.size()) {
+        if (node.IsString()) {
+            doc.GetEmbedded(node);
+        }
+        return;
+    }
+    const std::string& token = tokens[depth];
+    if (token == "*") {
+        if (node.IsMap()) {
+            for (const auto& [key, child] : node.AsMap()) {
+                ExpandEmbedded(doc, child, tokens, depth + 1);
+            }
+        } else if (node.IsArray()) {
+            for (const Node& child : node.AsArray()) {
+                ExpandEmbedded(doc, child, tokens, depth + 1);
+            }
+        }
+    } else if (const Node* child = detail::FindChild(node, token)) {
+        ExpandEmbedded(doc, *child, tokens, depth + 1);
+    }
+}
+
+JSON_INLINE void ExpandEmbeddedPaths(const Document& doc, const LoadOptions& options) {
+    for (const std::string& path : options.embedded_json_paths) {
+        ExpandEmbedded(doc, doc.GetRoot(), SplitPointer(path), 0);
+    }
+}
+
+}  // namespace detail
+
+JSON_INLINE Document ParseEmbedded(const Node& node, size_t max_depth) {
+    if (!node.IsString()) throw std::logic_error("Not a string");
+    return Document{detail::LoadNode(std::string_view(node.AsString()), max_depth)};
+}
+
+// Parsing happens outside the lock; when two threads race, the first result
+// is kept and the other one dropped
+JSON_INLINE const Node& Document::GetEmbedded(const Node& node) const {
+    if (!node.IsString()) throw std::logic_error("Not a string");
+    detail::EmbeddedTable& table = GetEmbeddedTable();
+    {
+        std::lock_guard lock(table.mutex);
+        if (auto it = table.documents.find(&node); it != table.documents.end()) {
+            return *it->second;
+        }
+    }
+    auto parsed = std::make_unique<const Node>(
+        detail::LoadNode(std::string_view(node.AsString()), LoadOptions{}.max_depth));
+    std::lock_guard lock(table.mutex);
+    return *table.documents.emplace(&node, std::move(parsed)).first->second;
+}
+
+JSON_INLINE Document Load(std::istream& input) {
+    const size_t max_depth = LoadOptions{}.max_depth;
+    detail::TraceScope trace(true, JSON_CALLER(), input.rdbuf(), max_depth);
+    return Document{detail::LoadNode(input, max_depth)};
+}
+
+JSON_INLINE Document Load(std::istream& input, const LoadOptions& options) {
+    detail::TraceScope trace(true, JSON_CALLER(), input.rdbuf(), options.max_depth);
+    Document doc{detail::LoadNode(input, options.max_depth)};
+    detail::ExpandEmbeddedPaths(doc, options);
+    return doc;
+}
+
+namespace detail {
+
+// Both overloads pass their own return address, so that the probes see the
+// call site in user code rather than the forwarding overload
+JSON_INLINE Document LoadText(std::string_view text, const LoadOptions& options, const void* caller) {
+    TraceScope trace(true, caller, nullptr, options.max_depth);
+    BufferSource src(text.data(), text.data() + text.size());
+    Document doc{LoadNode(src, options.max_depth)};
+    trace.SetBytes(src.Position());
+    ExpandEmbeddedPaths(doc, options);
+    return doc;
+}
+
+}  // namespace detail
+
+JSON_INLINE Document Load(std::string_view text) {
+    return detail::LoadText(text, LoadOptions{}, JSON_CALLER());
+}
+
+JSON_INLINE Document Load(std::string_view text, const LoadOptions& options) {
+    return detail::LoadText(text, options, JSON_CALLER());
+}
+
+JSON_INLINE void Print(const Document& doc, std::ostream& output) {
+    detail::TraceScope trace(false, JSON_CALLER(), output.rdbuf());
+    detail::PrintNode(doc.GetRoot(), output);
+}
+
+JSON_INLINE void PrintCompact(const Document& doc, std::ostream& output) {
+    std::string text;
+    detail::AppendCompact(text, doc.GetRoot());
+    output.write(text.data(), text.size());
+}
+
+}  // namespace json
@@ -0,0 +1,75 @@
+#include "json_mapped_file.h"
+
+#include <cerrno>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define JSON_HAS_MMAP 1
+#endif
+
+using namespace std;
+
+namespace json {
+
+#ifdef JSON_HAS_MMAP
+
+MappedFile::MappedFile(const string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw system_error(errno, generic_category(), "open " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        const int error = errno;
+        close(fd);
+        throw system_error(error, generic_category(), "fstat " + path);
+    }
+    size_ = static_cast<size_t>(info.st_size);
+    // An empty file can't be mapped, and doesn't need to be
+    if (size_ > 0) {
+        void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            const int error = errno;
+            close(fd);
+            throw system_error(error, generic_category(), "mmap " + path);
+        }
+        data_ = static_cast<const char*>(data);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+string_view MappedFile::GetText() const {
+    return string_view(data_, size_);
+}
+
+#else
+
+MappedFile::MappedFile(const string& path) {
+    ifstream input(path, ios::binary);
+    if (!input) {
+        throw system_error(make_error_code(errc::no_such_file_or_directory), "open " + path);
+    }
+    copy_.assign(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+}
+
+MappedFile::~MappedFile() = default;
+
+string_view MappedFile::GetText() const {
+    return copy_;
+}
+
+#endif
+
+}  // namespace json
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace json {
+
+    // A file mapped read-only into memory, to hand big inputs to the parsers
+    // without copying them. Where mmap is not available the file is read into
+    // memory instead.
+    class MappedFile {
+    public:
+        // Throws std::system_error when the file can't be opened or mapped
+        explicit MappedFile(const std::string& path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        std::string_view GetText() const;
+
+    private:
+        const char* data_ = nullptr;
+        size_t size_ = 0;
+        std::string copy_;
+    };
+
+}  // namespace json
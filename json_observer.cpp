@@ -0,0 +1,165 @@
+#include "json_observer.h"
+#include "json_detail.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace json {
+
+namespace {
+
+bool Matches(const vector<string>& pattern, const vector<string>& path) {
+    size_t common = min(pattern.size(), path.size());
+    for (size_t i = 0; i < common; ++i) {
+        if (pattern[i] != "*" && pattern[i] != path[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+ObservedDocument::ObservedDocument(Document doc)
+    : doc_(std::move(doc))
+    , dispatcher_([this] {
+        Dispatch();
+    }) {
+}
+
+ObservedDocument::~ObservedDocument() {
+    {
+        lock_guard lock(queue_mutex_);
+        stopping_ = true;
+    }
+    queue_cv_.notify_one();
+    dispatcher_.join();
+}
+
+uint64_t ObservedDocument::Subscribe(string_view pattern, ChangeListener listener) {
+    auto tokens = detail::SplitPointer(pattern);
+    lock_guard lock(subscriptions_mutex_);
+    uint64_t id = next_id_++;
+    subscriptions_.push_back(make_shared<const Subscription>(Subscription{id, std::move(tokens), std::move(listener)}));
+    return id;
+}
+
+void ObservedDocument::Unsubscribe(uint64_t id) {
+    {
+        lock_guard lock(subscriptions_mutex_);
+        erase_if(subscriptions_, [id](const auto& subscription) {
+            return subscription->id == id;
+        });
+    }
+    // A batch in flight may still hold the subscription; later ones won't.
+    // A listener unsubscribing itself is that batch and must not wait for it.
+    if (this_thread::get_id() != dispatcher_.get_id()) {
+        lock_guard dispatch_lock(dispatch_mutex_);
+    }
+}
+
+bool ObservedDocument::IsObserved(const vector<string>& path) const {
+    lock_guard lock(subscriptions_mutex_);
+    return any_of(subscriptions_.begin(), subscriptions_.end(), [&path](const auto& subscription) {
+        return Matches(subscription->pattern, path);
+    });
+}
+
+void ObservedDocument::Set(string_view pointer, Node value) {
+    vector<string> path = detail::SplitPointer(pointer);
+    string resolved(pointer);
+    // Report appends with the index the element actually got
+    if (!path.empty() && path.back() == "-") {
+        const vector<string> parent_path(path.begin(), path.end() - 1);
+        const Node* parent = detail::FindPointer(doc_.GetRoot(), parent_path);
+        if (parent != nullptr && parent->IsArray()) {
+            path.back() = to_string(parent->AsArray().size());
+            resolved.resize(resolved.size() - 1);
+            resolved += path.back();
+        }
+    }
+
+    optional<Node> old = doc_.Set(pointer, std::move(value));
+    if (!IsObserved(path)) {
+        return;
+    }
+    // Listeners get their own copy of the stored value, only made once the
+    // value is in place and someone listens
+    auto new_value = make_shared<const Node>(*detail::FindPointer(doc_.GetRoot(), path));
+    Enqueue(Change{std::move(resolved), old ? make_shared<const Node>(std::move(*old)) : nullptr, std::move(new_value)});
+}
+
+void ObservedDocument::Erase(string_view pointer) {
+    optional<Node> old = doc_.Erase(pointer);
+    if (old && IsObserved(detail::SplitPointer(pointer))) {
+        Enqueue(Change{string(pointer), make_shared<const Node>(std::move(*old)), nullptr});
+    }
+}
+
+const Document& ObservedDocument::GetDocument() const {
+    return doc_;
+}
+
+void ObservedDocument::Flush() {
+    unique_lock lock(queue_mutex_);
+    const uint64_t target = enqueued_;
+    delivered_cv_.wait(lock, [this, target] {
+        return delivered_ >= target;
+    });
+}
+
+void ObservedDocument::Enqueue(Change change) {
+    {
+        lock_guard lock(queue_mutex_);
+        queue_.push_back(std::move(change));
+        ++enqueued_;
+    }
+    queue_cv_.notify_one();
+}
+
+void ObservedDocument::Dispatch() {
+    unique_lock lock(queue_mutex_);
+    while (true) {
+        queue_cv_.wait(lock, [this] {
+            return stopping_ || !queue_.empty();
+        });
+        if (queue_.empty()) {
+            return;  // stopping and nothing left to deliver
+        }
+        vector<Change> batch = std::move(queue_);
+        queue_.clear();
+        lock.unlock();
+
+        unique_lock dispatch_lock(dispatch_mutex_);
+        vector<shared_ptr<const Subscription>> subscriptions;
+        {
+            lock_guard subscriptions_lock(subscriptions_mutex_);
+            subscriptions = subscriptions_;
+        }
+        vector<vector<string>> paths;
+        paths.reserve(batch.size());
+        for (const Change& change : batch) {
+            paths.push_back(detail::SplitPointer(change.path));
+        }
+        vector<Change> matched;
+        for (const auto& subscription : subscriptions) {
+            matched.clear();
+            for (size_t i = 0; i < batch.size(); ++i) {
+                if (Matches(subscription->pattern, paths[i])) {
+                    matched.push_back(batch[i]);
+                }
+            }
+            if (!matched.empty()) {
+                subscription->listener(matched);
+            }
+        }
+        dispatch_lock.unlock();
+
+        lock.lock();
+        delivered_ += batch.size();
+        delivered_cv_.notify_all();
+    }
+}
+
+}  // namespace json
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "json.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace json {
+
+    struct Change {
+        std::string path;
+        std::shared_ptr<const Node> old_value;  // nullptr when the value was added
+        std::shared_ptr<const Node> new_value;  // nullptr when the value was removed
+    };
+
+    using ChangeListener = std::function<void(const std::vector<Change>&)>;
+
+    // Document whose mutations are reported to subscribed listeners.
+    // Listeners run on a dispatcher thread and get every change queued since the
+    // previous delivery as one batch, so the writer only pays for queueing and,
+    // when someone listens, for a copy of the new value. Changes nobody listens
+    // to are not recorded at all. Reads of GetDocument() must be synchronized
+    // with Set/Erase by the caller; listeners must not throw.
+    class ObservedDocument {
+    public:
+        explicit ObservedDocument(Document doc);
+        ~ObservedDocument();
+
+        ObservedDocument(const ObservedDocument&) = delete;
+        ObservedDocument& operator=(const ObservedDocument&) = delete;
+
+        // pattern is a JSON Pointer where "*" matches any single token. A change
+        // matches when its path and the pattern agree on their common prefix, so
+        // "/users/*/name" hears about "/users/5/name" and "/users/5", and "/users"
+        // hears about everything under it.
+        uint64_t Subscribe(std::string_view pattern, ChangeListener listener);
+        // Waits for a batch being delivered, so the listener is never called
+        // once this returns (unless called from that listener itself)
+        void Unsubscribe(uint64_t id);
+
+        void Set(std::string_view pointer, Node value);
+        void Erase(std::string_view pointer);
+
+        const Document& GetDocument() const;
+
+        // Blocks until every change made so far has been delivered
+        void Flush();
+
+    private:
+        struct Subscription {
+            uint64_t id;
+            std::vector<std::string> pattern;
+            ChangeListener listener;
+        };
+
+        bool IsObserved(const std::vector<std::string>& path) const;
+        void Enqueue(Change change);
+        void Dispatch();
+
+        Document doc_;
+
+        mutable std::mutex subscriptions_mutex_;
+        std::vector<std::shared_ptr<const Subscription>> subscriptions_;
+        uint64_t next_id_ = 1;
+        // Held by the dispatcher while it calls listeners
+        std::mutex dispatch_mutex_;
+
+        std::mutex queue_mutex_;
+        std::condition_variable queue_cv_;
+        std::condition_variable delivered_cv_;
+        std::vector<Change> queue_;
+        uint64_t enqueued_ = 0;
+        uint64_t delivered_ = 0;
+        bool stopping_ = false;
+        std::thread dispatcher_;
+    };
+
+}  // namespace json
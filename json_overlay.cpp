@@ -0,0 +1,623 @@
+#include "json_overlay.h"
+#include "json_detail.h"
+#include "json_mapped_file.h"
+#include "json_tokenizer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <system_error>
+#include <unordered_map>
+
+#if __has_include(<unistd.h>)
+#include <unistd.h>
+#define JSON_HAS_GETPID 1
+#endif
+
+using namespace std;
+
+namespace json {
+
+struct OverlayView::Patch {
+    // The subtree was replaced
+    optional<Document> value;
+    bool erased = false;
+    // Changes below a container that is still read from the snapshot: dict
+    // members by key, array elements by their index in the snapshot
+    map<string, Patch> children;
+    // Arrays only: snapshot indices of the removed elements, ascending, and
+    // the elements added after the remaining ones
+    vector<size_t> removed;
+    vector<Patch> appended;
+
+    static Patch Replaced(Node value) {
+        Patch patch;
+        patch.value.emplace(std::move(value));
+        return patch;
+    }
+
+    static Patch Erased() {
+        Patch patch;
+        patch.erased = true;
+        return patch;
+    }
+
+    bool IsEmpty() const {
+        return !value && !erased && children.empty() && removed.empty() && appended.empty();
+    }
+};
+
+// Snapshot text, checked once, and the members of the containers read so far
+class OverlaySnapshot {
+public:
+    struct Container {
+        // First of duplicate keys wins, as in Load
+        map<string, string_view, less<>> members;
+        vector<string_view> items;
+    };
+
+    OverlaySnapshot(unique_ptr<MappedFile> file, string text, size_t max_depth)
+        : file_(std::move(file))
+        , text_(std::move(text))
+        , max_depth_(max_depth) {
+        const string_view all = file_ ? file_->GetText() : string_view(text_);
+        detail::BufferSource src(all.data(), all.data() + all.size());
+        src.SkipWhitespace();
+        const size_t start = src.Position();
+        detail::SkipValue(src, max_depth_);
+        root_ = all.substr(start, src.Position() - start);
+    }
+
+    string_view GetRoot() const {
+        return root_;
+    }
+
+    size_t GetMaxDepth() const {
+        return max_depth_;
+    }
+
+    // raw is a dict or an array of the snapshot
+    const Container& Index(string_view raw) const {
+        lock_guard lock(mutex_);
+        unique_ptr<Container>& entry = cache_[raw.data()];
+        if (!entry) {
+            entry = Build(raw);
+        }
+        return *entry;
+    }
+
+private:
+    static unique_ptr<Container> Build(string_view raw) {
+        auto container = make_unique<Container>();
+        const bool is_dict = raw.front() == '{';
+        detail::BufferSource src(raw.data() + 1, raw.data() + raw.size() - 1);
+        // The text was checked when the snapshot was opened
+        while (true) {
+            src.SkipWhitespace();
+            if (src.Peek() == detail::BufferSource::kEof) {
+                break;
+            }
+            string key;
+            if (is_dict) {
+                src.Get();
+                key = detail::ReadString(src);
+                src.SkipWhitespace();
+                src.Get();
+                src.SkipWhitespace();
+            }
+            const size_t start = src.Position();
+            detail::SkipValue(src, SIZE_MAX);
+            const string_view value = raw.substr(1 + start, src.Position() - start);
+            if (is_dict) {
+                container->members.emplace(std::move(key), value);
+            } else {
+                container->items.push_back(value);
+            }
+            src.SkipWhitespace();
+            src.Get();
+        }
+        return container;
+    }
+
+    unique_ptr<MappedFile> file_;
+    string text_;
+    size_t max_depth_;
+    string_view root_;
+    mutable mutex mutex_;
+    mutable unordered_map<const char*, unique_ptr<Container>> cache_;
+};
+
+namespace {
+
+// Snapshot index of the element at index of an array, given the snapshot
+// indices of its removed elements
+size_t SnapshotIndex(const vector<size_t>& removed, size_t index) {
+    for (size_t skipped : removed) {
+        if (skipped > index) {
+            break;
+        }
+        ++index;
+    }
+    return index;
+}
+
+// Name of a temporary file next to path, distinct for every flush
+string TemporaryPath(const string& path) {
+    static atomic<uint64_t> counter{0};
+    string temporary = path + ".tmp";
+#ifdef JSON_HAS_GETPID
+    temporary += '.' + to_string(getpid());
+#endif
+    return temporary + '.' + to_string(counter++);
+}
+
+string JoinPointer(const vector<string>& tokens, size_t from) {
+    string pointer;
+    for (size_t i = from; i < tokens.size(); ++i) {
+        detail::AppendPointerToken(pointer, tokens[i]);
+    }
+    return pointer;
+}
+
+}  // namespace
+
+OverlayView::OverlayView(const OverlaySnapshot* snapshot, string_view raw, const Patch* patch, const Node* node,
+                         shared_ptr<const void> owner)
+    : snapshot_(snapshot)
+    , raw_(raw)
+    , patch_(patch)
+    , node_(node)
+    , owner_(std::move(owner)) {
+    // A replaced subtree is read from its Node
+    if (patch_ != nullptr && patch_->value) {
+        node_ = &patch_->value->GetRoot();
+        patch_ = nullptr;
+    }
+}
+
+const Node& OverlayView::Scalar() const {
+    if (node_ != nullptr) {
+        return *node_;
+    }
+    if (!scalar_) {
+        scalar_ = Load(raw_).GetRoot();
+    }
+    return *scalar_;
+}
+
+bool OverlayView::IsNull() const {
+    return node_ != nullptr ? node_->IsNull() : raw_.front() == 'n';
+}
+
+bool OverlayView::IsArray() const {
+    return node_ != nullptr ? node_->IsArray() : raw_.front() == '[';
+}
+
+bool OverlayView::IsMap() const {
+    return node_ != nullptr ? node_->IsMap() : raw_.front() == '{';
+}
+
+bool OverlayView::IsBool() const {
+    return node_ != nullptr ? node_->IsBool() : raw_.front() == 't' || raw_.front() == 'f';
+}
+
+bool OverlayView::IsInt() const {
+    return !IsArray() && !IsMap() && Scalar().IsInt();
+}
+
+bool OverlayView::IsDouble() const {
+    return !IsArray() && !IsMap() && Scalar().IsDouble();
+}
+
+bool OverlayView::IsPureDouble() const {
+    return !IsArray() && !IsMap() && Scalar().IsPureDouble();
+}
+
+bool OverlayView::IsString() const {
+    return node_ != nullptr ? node_->IsString() : raw_.front() == '"';
+}
+
+bool OverlayView::AsBool() const {
+    if (IsArray() || IsMap()) throw logic_error("Not a bool");
+    return Scalar().AsBool();
+}
+
+int OverlayView::AsInt() const {
+    if (IsArray() || IsMap()) throw logic_error("Not an int");
+    return Scalar().AsInt();
+}
+
+double OverlayView::AsDouble() const {
+    if (IsArray() || IsMap()) throw logic_error("Not a double");
+    return Scalar().AsDouble();
+}
+
+string OverlayView::AsString() const {
+    if (IsArray() || IsMap()) throw logic_error("Not a string");
+    return Scalar().AsString();
+}
+
+optional<OverlayView> OverlayView::Child(const string& token) const {
+    if (node_ != nullptr) {
+        const Node* child = detail::FindChild(*node_, token);
+        return child ? optional(OverlayView(snapshot_, {}, nullptr, child, owner_)) : nullopt;
+    }
+    if (!IsArray() && !IsMap()) {
+        return nullopt;
+    }
+
+    const OverlaySnapshot::Container& container = snapshot_->Index(raw_);
+    string_view child_raw;
+    string key = token;
+    if (IsMap()) {
+        if (auto it = container.members.find(token); it != container.members.end()) {
+            child_raw = it->second;
+        }
+    } else {
+        const optional<size_t> index = detail::IndexToken(token);
+        if (!index) {
+            return nullopt;
+        }
+        size_t position = *index;
+        if (patch_ != nullptr) {
+            const size_t remaining = container.items.size() - patch_->removed.size();
+            if (position >= remaining) {
+                const size_t added = position - remaining;
+                return added < patch_->appended.size()
+                           ? optional(OverlayView(snapshot_, {}, &patch_->appended[added], nullptr, owner_))
+                           : nullopt;
+            }
+            position = SnapshotIndex(patch_->removed, position);
+            key = to_string(position);
+        }
+        if (position < container.items.size()) {
+            child_raw = container.items[position];
+        }
+    }
+
+    const Patch* child_patch = nullptr;
+    if (patch_ != nullptr) {
+        if (auto it = patch_->children.find(key); it != patch_->children.end()) {
+            if (it->second.erased) {
+                return nullopt;
+            }
+            if (it->second.value) {
+                return OverlayView(snapshot_, {}, &it->second, nullptr, owner_);
+            }
+            if (!it->second.IsEmpty()) {
+                child_patch = &it->second;
+            }
+        }
+    }
+    if (child_raw.empty()) {
+        return nullopt;
+    }
+    return OverlayView(snapshot_, child_raw, child_patch, nullptr, owner_);
+}
+
+size_t OverlayView::Size() const {
+    if (node_ != nullptr) {
+        return node_->IsArray() ? node_->AsArray().size() : node_->IsMap() ? node_->AsMap().size() : 0;
+    }
+    if (IsArray()) {
+        const size_t items = snapshot_->Index(raw_).items.size();
+        return patch_ == nullptr ? items : items - patch_->removed.size() + patch_->appended.size();
+    }
+    return IsMap() ? Keys().size() : 0;
+}
+
+vector<string> OverlayView::Keys() const {
+    vector<string> keys;
+    if (node_ != nullptr) {
+        if (node_->IsMap()) {
+            for (const auto& [key, value] : node_->AsMap()) {
+                keys.push_back(key);
+            }
+        }
+        return keys;
+    }
+    if (!IsMap()) {
+        return keys;
+    }
+    set<string> merged;
+    for (const auto& [key, value] : snapshot_->Index(raw_).members) {
+        merged.insert(key);
+    }
+    if (patch_ != nullptr) {
+        for (const auto& [key, child] : patch_->children) {
+            if (child.erased) {
+                merged.erase(key);
+            } else if (child.value) {
+                merged.insert(key);
+            }
+        }
+    }
+    return vector<string>(merged.begin(), merged.end());
+}
+
+optional<OverlayView> OverlayView::Find(const string& key) const {
+    return IsMap() ? Child(key) : nullopt;
+}
+
+optional<OverlayView> OverlayView::Find(size_t index) const {
+    return IsArray() ? Child(to_string(index)) : nullopt;
+}
+
+OverlayView OverlayView::At(const string& key) const {
+    if (optional<OverlayView> child = Find(key)) {
+        return *child;
+    }
+    throw out_of_range("No member " + key);
+}
+
+OverlayView OverlayView::At(size_t index) const {
+    if (optional<OverlayView> child = Find(index)) {
+        return *child;
+    }
+    throw out_of_range("No element " + to_string(index));
+}
+
+Node OverlayView::ToNode() const {
+    if (node_ != nullptr) {
+        return *node_;
+    }
+    if (patch_ == nullptr || (!IsArray() && !IsMap())) {
+        LoadOptions options;
+        options.max_depth = snapshot_->GetMaxDepth();
+        return Load(raw_, options).GetRoot();
+    }
+    if (IsArray()) {
+        Array array;
+        for (size_t i = 0, size = Size(); i < size; ++i) {
+            array.push_back(At(i).ToNode());
+        }
+        return Node(std::move(array));
+    }
+    Dict dict;
+    for (const string& key : Keys()) {
+        dict.emplace(key, At(key).ToNode());
+    }
+    return Node(std::move(dict));
+}
+
+// Writes the merged tree: snapshot text of untouched subtrees as is, the
+// rest in the compact form
+class OverlayWriter {
+public:
+    explicit OverlayWriter(ostream& output) : output_(output) {
+    }
+
+    void Write(const OverlayView& view) {
+        if (view.node_ != nullptr) {
+            buffer_.clear();
+            detail::AppendCompact(buffer_, *view.node_);
+            output_.write(buffer_.data(), buffer_.size());
+        } else if (view.patch_ == nullptr || (!view.IsArray() && !view.IsMap())) {
+            output_.write(view.raw_.data(), view.raw_.size());
+        } else if (view.IsArray()) {
+            output_.put('[');
+            for (size_t i = 0, size = view.Size(); i < size; ++i) {
+                if (i > 0) {
+                    output_.put(',');
+                }
+                Write(view.At(i));
+            }
+            output_.put(']');
+        } else {
+            output_.put('{');
+            bool first = true;
+            for (const string& key : view.Keys()) {
+                if (!first) {
+                    output_.put(',');
+                }
+                first = false;
+                buffer_.clear();
+                detail::AppendString(buffer_, key);
+                buffer_ += ':';
+                output_.write(buffer_.data(), buffer_.size());
+                Write(view.At(key));
+            }
+            output_.put('}');
+        }
+    }
+
+private:
+    ostream& output_;
+    string buffer_;
+};
+
+OverlayDocument::OverlayDocument(const string& path, size_t max_depth)
+    : OverlayDocument(make_shared<const OverlaySnapshot>(make_unique<MappedFile>(path), string(), max_depth)) {
+}
+
+OverlayDocument OverlayDocument::FromText(string text, size_t max_depth) {
+    return OverlayDocument(make_shared<const OverlaySnapshot>(nullptr, std::move(text), max_depth));
+}
+
+OverlayDocument::OverlayDocument(shared_ptr<const OverlaySnapshot> snapshot)
+    : snapshot_(std::move(snapshot))
+    , root_(make_shared<Patch>()) {
+}
+
+OverlayView OverlayDocument::GetRoot() const {
+    return OverlayView(snapshot_.get(), snapshot_->GetRoot(), root_.get(), nullptr);
+}
+
+optional<OverlayView> OverlayDocument::Find(string_view pointer) const {
+    optional<OverlayView> view = GetRoot();
+    for (const string& token : detail::SplitPointer(pointer)) {
+        if (view = view->Child(token); !view) {
+            break;
+        }
+    }
+    return view;
+}
+
+OverlayDocument::Patch& OverlayDocument::ChildPatch(Patch& patch, const OverlayView& view, const string& token) {
+    if (view.IsMap()) {
+        return patch.children[token];
+    }
+    const size_t remaining = view.snapshot_->Index(view.raw_).items.size() - patch.removed.size();
+    const size_t index = *detail::IndexToken(token);
+    if (index >= remaining) {
+        return patch.appended[index - remaining];
+    }
+    return patch.children[to_string(SnapshotIndex(patch.removed, index))];
+}
+
+OverlayView OverlayDocument::Detach(string_view raw, Patch&& old) const {
+    struct Detached {
+        shared_ptr<const OverlaySnapshot> snapshot;
+        Patch patch;
+    };
+    auto detached = make_shared<Detached>(Detached{snapshot_, std::move(old)});
+    const Patch* patch = detached->patch.IsEmpty() ? nullptr : &detached->patch;
+    return OverlayView(snapshot_.get(), raw, patch, nullptr, std::move(detached));
+}
+
+optional<OverlayView> OverlayDocument::Detach(optional<Node> old) const {
+    if (!old) {
+        return nullopt;
+    }
+    return Detach({}, Patch::Replaced(std::move(*old)));
+}
+
+optional<OverlayView> OverlayDocument::Set(string_view pointer, Node value) {
+    const vector<string> tokens = detail::SplitPointer(pointer);
+    if (tokens.empty()) {
+        OverlayView old = Detach(snapshot_->GetRoot(), std::move(*root_));
+        *root_ = Patch::Replaced(std::move(value));
+        return old;
+    }
+
+    Patch* patch = root_.get();
+    OverlayView view = GetRoot();
+    for (size_t i = 0; i + 1 < tokens.size(); ++i) {
+        if (patch->value) {
+            return Detach(patch->value->Set(JoinPointer(tokens, i), std::move(value)));
+        }
+        optional<OverlayView> child = view.Child(tokens[i]);
+        if (!child || !(child->IsArray() || child->IsMap())) {
+            throw out_of_range("No container at the parent of " + string(pointer));
+        }
+        patch = &ChildPatch(*patch, view, tokens[i]);
+        view = *child;
+    }
+    const string& token = tokens.back();
+    if (patch->value) {
+        return Detach(patch->value->Set(JoinPointer(tokens, tokens.size() - 1), std::move(value)));
+    }
+    if (!view.IsArray() && !view.IsMap()) {
+        throw out_of_range("No container at the parent of " + string(pointer));
+    }
+
+    if (optional<OverlayView> old_view = view.Child(token)) {
+        Patch& child = ChildPatch(*patch, view, token);
+        OverlayView old = Detach(old_view->raw_, std::move(child));
+        child = Patch::Replaced(std::move(value));
+        return old;
+    }
+    if (view.IsMap()) {
+        patch->children[token] = Patch::Replaced(std::move(value));
+        return nullopt;
+    }
+    if (token == "-" || token == to_string(view.Size())) {
+        patch->appended.push_back(Patch::Replaced(std::move(value)));
+        return nullopt;
+    }
+    throw out_of_range("Array index out of range: " + string(pointer));
+}
+
+optional<OverlayView> OverlayDocument::Erase(string_view pointer) {
+    const vector<string> tokens = detail::SplitPointer(pointer);
+    if (tokens.empty()) {
+        OverlayView old = Detach(snapshot_->GetRoot(), std::move(*root_));
+        *root_ = Patch::Replaced(Node{});
+        return old;
+    }
+
+    Patch* patch = root_.get();
+    OverlayView view = GetRoot();
+    for (size_t i = 0; i + 1 < tokens.size(); ++i) {
+        if (patch->value) {
+            return Detach(patch->value->Erase(JoinPointer(tokens, i)));
+        }
+        optional<OverlayView> child = view.Child(tokens[i]);
+        if (!child) {
+            return nullopt;
+        }
+        patch = &ChildPatch(*patch, view, tokens[i]);
+        view = *child;
+    }
+    const string& token = tokens.back();
+    if (patch->value) {
+        return Detach(patch->value->Erase(JoinPointer(tokens, tokens.size() - 1)));
+    }
+
+    optional<OverlayView> old_view = view.Child(token);
+    if (!old_view) {
+        return nullopt;
+    }
+    OverlayView old = Detach(old_view->raw_, std::move(ChildPatch(*patch, view, token)));
+    if (view.IsMap()) {
+        patch->children[token] = Patch::Erased();
+        return old;
+    }
+    const size_t remaining = snapshot_->Index(view.raw_).items.size() - patch->removed.size();
+    const size_t index = *detail::IndexToken(token);
+    if (index >= remaining) {
+        patch->appended.erase(patch->appended.begin() + static_cast<ptrdiff_t>(index - remaining));
+    } else {
+        const size_t position = SnapshotIndex(patch->removed, index);
+        patch->children.erase(to_string(position));
+        patch->removed.insert(upper_bound(patch->removed.begin(), patch->removed.end(), position), position);
+    }
+    return old;
+}
+
+size_t OverlayDocument::PatchCount() const {
+    auto count = [](const Patch& patch, auto& self) -> size_t {
+        size_t result = (patch.value || patch.erased ? 1 : 0) + patch.removed.size();
+        for (const auto& [key, child] : patch.children) {
+            result += self(child, self);
+        }
+        for (const Patch& child : patch.appended) {
+            result += self(child, self);
+        }
+        return result;
+    };
+    return count(*root_, count);
+}
+
+future<void> OverlayDocument::FlushAsync(const string& path) const {
+    // The copy keeps the output independent of later changes; the patches
+    // are small next to the snapshot
+    auto patch = make_shared<const Patch>(*root_);
+    return async(launch::async, [snapshot = snapshot_, patch, path] {
+        const string temporary = TemporaryPath(path);
+        {
+            ofstream output(temporary, ios::binary | ios::trunc);
+            OverlayWriter(output).Write(OverlayView(snapshot.get(), snapshot->GetRoot(), patch.get(), nullptr));
+            output.close();
+            if (!output) {
+                remove(temporary.c_str());
+                throw system_error(make_error_code(errc::io_error), "write " + temporary);
+            }
+        }
+        if (rename(temporary.c_str(), path.c_str()) != 0) {
+            const int error = errno;
+            remove(temporary.c_str());
+            throw system_error(error, generic_category(), "rename " + temporary);
+        }
+    });
+}
+
+void OverlayDocument::Flush(const string& path) const {
+    FlushAsync(path).get();
+}
+
+}  // namespace json
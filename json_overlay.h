@@ -0,0 +1,124 @@
+#pragma once
+
+#include "json.h"
+
+#include <cstddef>
+#include <future>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Copy-on-write layer over a read-only JSON snapshot (usually a mapped file).
+// Reads of unmodified parts go straight to the snapshot text, container
+// members being indexed on first access; changes are kept as heap Nodes for
+// the modified subtrees only. Flushing writes a new snapshot where untouched
+// subtrees are copied byte for byte.
+
+namespace json {
+
+    class OverlaySnapshot;
+    class OverlayDocument;
+    class OverlayWriter;
+
+    // A value of the merged tree. Stays valid until the next change of the
+    // OverlayDocument it came from, except for the old values returned by
+    // Set and Erase, which hold what they need themselves.
+    class OverlayView {
+    public:
+        bool IsNull() const;
+        bool IsArray() const;
+        bool IsMap() const;
+        bool IsBool() const;
+        bool IsInt() const;
+        bool IsDouble() const;
+        bool IsPureDouble() const;
+        bool IsString() const;
+
+        // Throw std::logic_error on a type mismatch, like the Node accessors
+        bool AsBool() const;
+        int AsInt() const;
+        double AsDouble() const;
+        std::string AsString() const;
+
+        // Members of a dict (sorted, as in Dict) or elements of an array
+        size_t Size() const;
+        std::vector<std::string> Keys() const;
+        std::optional<OverlayView> Find(const std::string& key) const;
+        std::optional<OverlayView> Find(size_t index) const;
+        // Throw std::out_of_range when there is no such member or element
+        OverlayView At(const std::string& key) const;
+        OverlayView At(size_t index) const;
+
+        // Builds the subtree as Nodes
+        Node ToNode() const;
+
+    private:
+        friend class OverlayDocument;
+        friend class OverlayWriter;
+        struct Patch;
+
+        OverlayView(const OverlaySnapshot* snapshot, std::string_view raw, const Patch* patch, const Node* node,
+                    std::shared_ptr<const void> owner = nullptr);
+
+        std::optional<OverlayView> Child(const std::string& token) const;
+        const Node& Scalar() const;
+
+        const OverlaySnapshot* snapshot_;
+        // Exactly one of raw_ (snapshot text of the value) and node_ is set
+        std::string_view raw_;
+        const Patch* patch_;
+        const Node* node_;
+        // Set for a value detached from its document, shared with its children
+        std::shared_ptr<const void> owner_;
+        mutable std::optional<Node> scalar_;
+    };
+
+    class OverlayDocument {
+    public:
+        // Maps a snapshot file. Throws std::system_error when it can't be read
+        // and ParsingError when it doesn't hold valid JSON.
+        explicit OverlayDocument(const std::string& path, size_t max_depth = LoadOptions{}.max_depth);
+        // A snapshot held in memory
+        static OverlayDocument FromText(std::string text, size_t max_depth = LoadOptions{}.max_depth);
+
+        OverlayDocument(OverlayDocument&&) = default;
+        OverlayDocument& operator=(OverlayDocument&&) = default;
+
+        OverlayView GetRoot() const;
+        std::optional<OverlayView> Find(std::string_view pointer) const;
+
+        // Same contracts as Document::Set and Document::Erase, except that the
+        // old value comes back as a view: nothing is built unless it is read.
+        // Array elements are added and removed one by one, the rest of the
+        // array staying in the snapshot.
+        std::optional<OverlayView> Set(std::string_view pointer, Node value);
+        std::optional<OverlayView> Erase(std::string_view pointer);
+
+        // Number of changed subtrees held on the heap, plus removed elements
+        size_t PatchCount() const;
+
+        // Writes the merged document to path (through a temporary file of its
+        // own, renamed over it) on a background thread. Later changes don't affect the
+        // output. The future rethrows write errors.
+        std::future<void> FlushAsync(const std::string& path) const;
+        void Flush(const std::string& path) const;
+
+    private:
+        using Patch = OverlayView::Patch;
+
+        explicit OverlayDocument(std::shared_ptr<const OverlaySnapshot> snapshot);
+
+        // Patch of an existing child of view, created on demand
+        static Patch& ChildPatch(Patch& patch, const OverlayView& view, const std::string& token);
+        // Old values, taken out of the tree, as views that keep them alive
+        OverlayView Detach(std::string_view raw, Patch&& old) const;
+        std::optional<OverlayView> Detach(std::optional<Node> old) const;
+
+        std::shared_ptr<const OverlaySnapshot> snapshot_;
+        std::shared_ptr<Patch> root_;
+    };
+
+}  // namespace json
@@ -0,0 +1,358 @@
+#include "json_parallel.h"
+#include "json_detail.h"
+#include "json_tokenizer.h"
+#include "json_workers.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+
+using namespace std;
+
+namespace json {
+
+namespace {
+
+enum class StringState : uint8_t { kOutside, kInside, kEscaped };
+
+StringState Advance(StringState state, const char* p, const char* end) {
+    for (; p != end; ++p) {
+        switch (state) {
+            case StringState::kOutside:
+                if (*p == '"') {
+                    state = StringState::kInside;
+                }
+                break;
+            case StringState::kInside:
+                if (*p == '\\') {
+                    state = StringState::kEscaped;
+                } else if (*p == '"') {
+                    state = StringState::kOutside;
+                }
+                break;
+            case StringState::kEscaped:
+                state = StringState::kInside;
+                break;
+        }
+    }
+    return state;
+}
+
+bool IsStructural(char c) {
+    return c == '[' || c == ']' || c == '{' || c == '}' || c == ',' || c == ':';
+}
+
+// Position just after the first structural character outside strings at or
+// after pos. No token can straddle such a position.
+size_t NextSplitPoint(string_view text, size_t pos, StringState state) {
+    for (; pos < text.size(); ++pos) {
+        const char c = text[pos];
+        if (state == StringState::kOutside && IsStructural(c)) {
+            return pos + 1;
+        }
+        state = Advance(state, &text[pos], &text[pos] + 1);
+    }
+    return text.size();
+}
+
+// Container being filled. The same state machine is used inside chunks and
+// while stitching, so both apply exactly the grammar of the serial parser.
+struct Frame {
+    enum class Expect { kFirst, kItem, kColon, kValue, kNext };
+
+    explicit Frame(bool dict) : is_dict(dict) {
+    }
+
+    void AddValue(Node value) {
+        if (!is_dict && (expect == Expect::kFirst || expect == Expect::kItem)) {
+            array.push_back(std::move(value));
+        } else if (is_dict && expect == Expect::kValue) {
+            dict.emplace(std::move(key), std::move(value));
+        } else {
+            throw ParsingError(is_dict ? "Unexpected value in dict" : "Expected ',' or ']' in array");
+        }
+        expect = Expect::kNext;
+    }
+
+    void AddString(string value) {
+        if (is_dict && (expect == Expect::kFirst || expect == Expect::kItem)) {
+            key = std::move(value);
+            expect = Expect::kColon;
+        } else {
+            AddValue(Node(std::move(value)));
+        }
+    }
+
+    void Comma() {
+        if (expect != Expect::kNext) {
+            throw ParsingError("Unexpected ','");
+        }
+        expect = Expect::kItem;
+    }
+
+    void Colon() {
+        if (!is_dict || expect != Expect::kColon) {
+            throw ParsingError("Unexpected ':'");
+        }
+        expect = Expect::kValue;
+    }
+
+    Node Close(bool dict_bracket) {
+        if (dict_bracket != is_dict || (expect != Expect::kFirst && expect != Expect::kNext)) {
+            throw ParsingError(is_dict ? "Expected ',' or '}' in dict" : "Expected ',' or ']' in array");
+        }
+        return is_dict ? Node(std::move(dict)) : Node(std::move(array));
+    }
+
+    bool is_dict;
+    Expect expect = Expect::kFirst;
+    Array array;
+    Dict dict;
+    string key;
+};
+
+// What a chunk could not resolve on its own, in text order
+struct Event {
+    enum class Type { kValue, kString, kEnd, kComma, kColon, kPartial };
+
+    Type type;
+    bool is_dict = false;
+    Node value;
+    string text;
+    optional<Frame> frame;
+};
+
+struct ChunkResult {
+    vector<Event> events;
+    // Deepest nesting reached, relative to the depth at the chunk start
+    ptrdiff_t max_depth = 0;
+};
+
+class ChunkParser {
+public:
+    ChunkParser(const char* begin, const char* end, size_t max_depth)
+        : src_(begin, end)
+        , max_depth_(max_depth) {
+    }
+
+    ChunkResult Parse() {
+        while (true) {
+            src_.SkipWhitespace();
+            const int c = src_.Peek();
+            if (c == detail::BufferSource::kEof) {
+                break;
+            }
+            if (c == '[' || c == '{') {
+                src_.Get();
+                Begin(c == '{');
+            } else if (c == ']' || c == '}') {
+                src_.Get();
+                End(c == '}');
+            } else if (c == ',') {
+                src_.Get();
+                Punctuation(Event::Type::kComma);
+            } else if (c == ':') {
+                src_.Get();
+                Punctuation(Event::Type::kColon);
+            } else if (c == '"') {
+                src_.Get();
+                String(detail::ReadString(src_));
+            } else if (detail::HasClass(c, detail::kDigit) || c == '-') {
+                Value(detail::ReadNumber(src_));
+            } else if (detail::HasClass(c, detail::kAlpha)) {
+                Value(detail::ReadLiteral(src_));
+            } else {
+                throw ParsingError("Unexpected character: " + string(1, static_cast<char>(c)));
+            }
+        }
+        for (Frame& frame : stack_) {
+            result_.events.push_back({Event::Type::kPartial, frame.is_dict, {}, {}, std::move(frame)});
+        }
+        return std::move(result_);
+    }
+
+private:
+    void Begin(bool is_dict) {
+        stack_.emplace_back(is_dict);
+        // Frames opened in this chunk are open at the same time whatever the
+        // depth at the chunk start is
+        if (stack_.size() > max_depth_) {
+            throw ParsingError("Nesting is too deep");
+        }
+        result_.max_depth = max(result_.max_depth, static_cast<ptrdiff_t>(stack_.size()) - outer_ends_);
+    }
+
+    void End(bool is_dict) {
+        if (stack_.empty()) {
+            result_.events.push_back({Event::Type::kEnd, is_dict, {}, {}, {}});
+            ++outer_ends_;
+            return;
+        }
+        Node node = stack_.back().Close(is_dict);
+        stack_.pop_back();
+        Value(std::move(node));
+    }
+
+    void Punctuation(Event::Type type) {
+        if (stack_.empty()) {
+            result_.events.push_back({type, false, {}, {}, {}});
+        } else if (type == Event::Type::kComma) {
+            stack_.back().Comma();
+        } else {
+            stack_.back().Colon();
+        }
+    }
+
+    void Value(Node&& value) {
+        if (stack_.empty()) {
+            result_.events.push_back({Event::Type::kValue, false, std::move(value), {}, {}});
+        } else {
+            stack_.back().AddValue(std::move(value));
+        }
+    }
+
+    void String(string value) {
+        if (stack_.empty()) {
+            result_.events.push_back({Event::Type::kString, false, {}, std::move(value), {}});
+        } else {
+            stack_.back().AddString(std::move(value));
+        }
+    }
+
+    detail::BufferSource src_;
+    size_t max_depth_;
+    vector<Frame> stack_;
+    ptrdiff_t outer_ends_ = 0;
+    ChunkResult result_;
+};
+
+class Stitcher {
+public:
+    explicit Stitcher(size_t max_depth) : max_depth_(max_depth) {
+    }
+
+    void Add(ChunkResult& chunk) {
+        if (static_cast<ptrdiff_t>(stack_.size()) + chunk.max_depth > static_cast<ptrdiff_t>(max_depth_)) {
+            throw ParsingError("Nesting is too deep");
+        }
+        for (Event& event : chunk.events) {
+            switch (event.type) {
+                case Event::Type::kValue:
+                    Value(std::move(event.value));
+                    break;
+                case Event::Type::kString:
+                    if (stack_.empty()) {
+                        Value(Node(std::move(event.text)));
+                    } else {
+                        stack_.back().AddString(std::move(event.text));
+                    }
+                    break;
+                case Event::Type::kPartial:
+                    Push(std::move(*event.frame));
+                    break;
+                case Event::Type::kEnd: {
+                    if (stack_.empty()) {
+                        throw ParsingError("Unexpected closing bracket");
+                    }
+                    Node node = stack_.back().Close(event.is_dict);
+                    stack_.pop_back();
+                    Value(std::move(node));
+                    break;
+                }
+                case Event::Type::kComma:
+                case Event::Type::kColon:
+                    if (stack_.empty()) {
+                        throw ParsingError("Unexpected punctuation outside of a container");
+                    }
+                    if (event.type == Event::Type::kComma) {
+                        stack_.back().Comma();
+                    } else {
+                        stack_.back().Colon();
+                    }
+                    break;
+            }
+        }
+    }
+
+    Node Finish() {
+        if (!stack_.empty() || !root_) {
+            throw ParsingError("Unexpected end of input");
+        }
+        return std::move(*root_);
+    }
+
+private:
+    void Push(Frame frame) {
+        if (stack_.empty() && root_) {
+            throw ParsingError("Unexpected content after the document");
+        }
+        stack_.push_back(std::move(frame));
+    }
+
+    void Value(Node&& value) {
+        if (!stack_.empty()) {
+            stack_.back().AddValue(std::move(value));
+        } else if (root_) {
+            throw ParsingError("Unexpected content after the document");
+        } else {
+            root_ = std::move(value);
+        }
+    }
+
+    size_t max_depth_;
+    vector<Frame> stack_;
+    optional<Node> root_;
+};
+
+}  // namespace
+
+Document LoadParallel(string_view text, const ParallelLoadOptions& options) {
+    const unsigned threads = detail::ResolveThreads(options.threads);
+    const size_t min_chunk = max<size_t>(options.min_chunk_size, 1);
+    const size_t chunk_count = clamp<size_t>(text.size() / min_chunk, 1, size_t{threads} * 4);
+
+    vector<size_t> bounds(chunk_count + 1);
+    for (size_t i = 0; i <= chunk_count; ++i) {
+        bounds[i] = text.size() / chunk_count * i;
+    }
+    bounds[chunk_count] = text.size();
+
+    // Prefix pass: how every chunk maps a string state at its start to the state
+    // at its end, then the actual state at every boundary
+    vector<array<StringState, 3>> transitions(chunk_count);
+    detail::ParallelFor(chunk_count, threads, [&](size_t i) {
+        for (StringState state : {StringState::kOutside, StringState::kInside, StringState::kEscaped}) {
+            transitions[i][static_cast<size_t>(state)]
+                = Advance(state, text.data() + bounds[i], text.data() + bounds[i + 1]);
+        }
+    });
+    vector<StringState> start_states(chunk_count);
+    start_states[0] = StringState::kOutside;
+    for (size_t i = 1; i < chunk_count; ++i) {
+        start_states[i] = transitions[i - 1][static_cast<size_t>(start_states[i - 1])];
+    }
+
+    vector<size_t> starts(chunk_count + 1);
+    starts[chunk_count] = text.size();
+    detail::ParallelFor(chunk_count, threads, [&](size_t i) {
+        starts[i] = i == 0 ? 0 : NextSplitPoint(text, bounds[i], start_states[i]);
+    });
+
+    vector<ChunkResult> chunks(chunk_count);
+    detail::ParallelFor(chunk_count, threads, [&](size_t i) {
+        chunks[i] = ChunkParser(text.data() + starts[i], text.data() + max(starts[i], starts[i + 1]),
+                                options.load.max_depth)
+                        .Parse();
+    });
+
+    Stitcher stitcher(options.load.max_depth);
+    for (ChunkResult& chunk : chunks) {
+        stitcher.Add(chunk);
+    }
+    Document doc{stitcher.Finish()};
+    detail::ExpandEmbeddedPaths(doc, options.load);
+    return doc;
+}
+
+}  // namespace json
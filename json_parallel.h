@@ -0,0 +1,26 @@
+#pragma once
+
+#include "json.h"
+
+#include <cstddef>
+#include <string_view>
+
+namespace json {
+
+    struct ParallelLoadOptions {
+        LoadOptions load;
+        // 0 means std::thread::hardware_concurrency()
+        unsigned threads = 0;
+        // Texts are split into chunks of at least this many bytes
+        size_t min_chunk_size = 1 << 20;
+    };
+
+    // Parses a document held in memory on several threads, whatever its shape.
+    // The text is split into chunks, a prefix pass finds out which chunk
+    // boundaries fall inside strings, every chunk is parsed into partial subtrees
+    // on its own, and the pieces are stitched together in order.
+    // Builds the same tree as Load, but unlike Load rejects anything other than
+    // whitespace after the root value.
+    Document LoadParallel(std::string_view text, const ParallelLoadOptions& options = {});
+
+}  // namespace json
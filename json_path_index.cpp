@@ -0,0 +1,97 @@
+#include "json_path_index.h"
+#include "json_detail.h"
+
+using namespace std;
+
+namespace json {
+
+namespace {
+
+// True when path is prefix itself or lies under it
+bool IsUnder(string_view path, string_view prefix) {
+    return path.substr(0, prefix.size()) == prefix
+           && (path.size() == prefix.size() || path[prefix.size()] == '/');
+}
+
+}  // namespace
+
+PathIndex::PathIndex(const Document& doc) : PathIndex(doc, {""s}) {
+}
+
+PathIndex::PathIndex(const Document& doc, vector<string> prefixes)
+    : doc_(&doc)
+    , prefixes_(std::move(prefixes)) {
+    for (const string& prefix : prefixes_) {
+        IndexSubtree(prefix);
+    }
+}
+
+const Node* PathIndex::Find(string_view pointer) const {
+    auto it = nodes_.find(pointer);
+    return it == nodes_.end() ? nullptr : it->second;
+}
+
+size_t PathIndex::Size() const {
+    return nodes_.size();
+}
+
+void PathIndex::Rebuild(string_view pointer) {
+    for (const string& prefix : prefixes_) {
+        if (IsUnder(pointer, prefix)) {
+            Remove(string(pointer));
+            IndexSubtree(string(pointer));
+        } else if (IsUnder(prefix, pointer)) {
+            Remove(prefix);
+            IndexSubtree(prefix);
+        }
+    }
+}
+
+void PathIndex::Add(const Node& node, string& path) {
+    if (auto [it, inserted] = nodes_.emplace(path, &node); inserted) {
+        ordered_.insert(it->first);
+    } else {
+        it->second = &node;
+    }
+
+    const size_t size = path.size();
+    if (node.IsMap()) {
+        for (const auto& [key, child] : node.AsMap()) {
+            detail::AppendPointerToken(path, key);
+            Add(child, path);
+            path.resize(size);
+        }
+    } else if (node.IsArray()) {
+        const Array& array = node.AsArray();
+        for (size_t i = 0; i < array.size(); ++i) {
+            path += '/';
+            path += to_string(i);
+            Add(array[i], path);
+            path.resize(size);
+        }
+    }
+}
+
+void PathIndex::Remove(const string& pointer) {
+    // "/a" and everything in ["/a/", "/a0") where '0' follows '/' in ASCII
+    auto first = ordered_.lower_bound(pointer);
+    auto last = ordered_.lower_bound(pointer + '0');
+    for (auto it = first; it != last;) {
+        if (IsUnder(*it, pointer)) {
+            string_view key = *it;
+            it = ordered_.erase(it);
+            nodes_.erase(nodes_.find(key));
+        } else {
+            ++it;
+        }
+    }
+}
+
+void PathIndex::IndexSubtree(const string& pointer) {
+    if (const Node* node = detail::FindPointer(doc_->GetRoot(), detail::SplitPointer(pointer))) {
+        string path = pointer;
+        Add(*node, path);
+    }
+}
+
+}  // namespace json
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "json.h"
+
+#include <functional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace json {
+
+    // Hash index from JSON Pointer ("/a/0/b", root is "") to the node at that path.
+    // Lookup by full path is a single hash probe instead of a walk through the
+    // nested containers. Pointers stay valid while the indexed Document is alive
+    // and unchanged; after a subtree changes, call Rebuild for its path.
+    class PathIndex {
+    public:
+        // Indexes every path of the document
+        explicit PathIndex(const Document& doc);
+        // Indexes only the subtrees at the given JSON Pointers
+        PathIndex(const Document& doc, std::vector<std::string> prefixes);
+
+        // Returns nullptr when the path is absent or not indexed
+        const Node* Find(std::string_view pointer) const;
+        size_t Size() const;
+
+        // Drops every entry at or under the pointer and indexes the current
+        // subtree there again. Pass the deepest container whose children were
+        // added, removed or replaced.
+        void Rebuild(std::string_view pointer);
+
+    private:
+        struct Hash {
+            using is_transparent = void;
+            size_t operator()(std::string_view path) const {
+                return std::hash<std::string_view>{}(path);
+            }
+        };
+
+        void Add(const Node& node, std::string& path);
+        void Remove(const std::string& pointer);
+        void IndexSubtree(const std::string& pointer);
+
+        const Document* doc_;
+        std::vector<std::string> prefixes_;
+        std::unordered_map<std::string, const Node*, Hash, std::equal_to<>> nodes_;
+        // Same keys in path order, so that a subtree is a contiguous range
+        std::set<std::string_view> ordered_;
+    };
+
+}  // namespace json
@@ -0,0 +1,39 @@
+#include "json_probes.h"
+
+#ifdef JSON_USDT
+
+// Here only, so that the semaphores don't change how the probes of other code
+// expand
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define JSON_USDT_SEMAPHORE(probe) \
+    unsigned short json_##probe##_semaphore __attribute__((section(".probes"))) = 0
+JSON_USDT_SEMAPHORE(load_entry);
+JSON_USDT_SEMAPHORE(load_return);
+JSON_USDT_SEMAPHORE(print_entry);
+JSON_USDT_SEMAPHORE(print_return);
+#undef JSON_USDT_SEMAPHORE
+
+namespace json::detail {
+
+void FireEntryProbe(bool is_load, const void* caller) {
+    if (is_load) {
+        DTRACE_PROBE1(json, load_entry, caller);
+    } else {
+        DTRACE_PROBE1(json, print_entry, caller);
+    }
+}
+
+void FireReturnProbe(bool is_load, const void* caller, uint64_t bytes, uint64_t nodes, uint64_t depth,
+                     uint64_t cycles) {
+    if (is_load) {
+        DTRACE_PROBE5(json, load_return, caller, bytes, nodes, depth, cycles);
+    } else {
+        DTRACE_PROBE5(json, print_return, caller, bytes, nodes, depth, cycles);
+    }
+}
+
+}  // namespace json::detail
+
+#endif
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ios>
+#include <streambuf>
+
+// Linux USDT tracepoints for attaching bpftrace/perf to a running process:
+//   json:load_entry(caller)
+//   json:load_return(caller, bytes, nodes, depth, cycles)
+//   json:print_entry(caller)
+//   json:print_return(caller, bytes, nodes, depth, cycles)
+// caller is the return address of the Load/Print call (with JSON_HEADER_ONLY,
+// of the function Load/Print got inlined into), bytes is 0 for streams that
+// can't report their position, depth is 0 for a scalar or an empty root.
+// Compiled out unless <sys/sdt.h> is available; define JSON_DISABLE_USDT to
+// compile them out anyway. See json_latency.bt for an example.
+//
+// The probes have semaphores, which the tracer raises while it is attached,
+// so that without a tracer Load and Print neither count nodes nor read the
+// clock or the stream position. The probes themselves are in json_probes.cpp,
+// the only file that includes <sys/sdt.h> (with _SDT_HAS_SEMAPHORES), so that
+// probes of the including code are left as they are, also with
+// JSON_HEADER_ONLY.
+
+#if !defined(JSON_DISABLE_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define JSON_USDT 1
+#endif
+#endif
+
+#ifdef JSON_USDT
+// The names are fixed by <sys/sdt.h>: <provider>_<probe>_semaphore. Defined
+// in json_probes.cpp.
+extern unsigned short json_load_entry_semaphore;
+extern unsigned short json_load_return_semaphore;
+extern unsigned short json_print_entry_semaphore;
+extern unsigned short json_print_return_semaphore;
+#define JSON_USDT_ENABLED(probe) (__builtin_expect(json_##probe##_semaphore, 0) != 0)
+#endif
+
+#if defined(JSON_USDT) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
+
+namespace json::detail {
+
+#ifdef JSON_USDT
+
+    struct TraceCounters {
+        size_t nodes = 0;
+        size_t depth = 0;
+        // The parser counts nesting down from LoadOptions::max_depth
+        size_t min_depth_left = SIZE_MAX;
+    };
+
+    inline thread_local TraceCounters trace_counters;
+
+    // Fire the probes (defined in json_probes.cpp)
+    void FireEntryProbe(bool is_load, const void* caller);
+    void FireReturnProbe(bool is_load, const void* caller, uint64_t bytes, uint64_t nodes, uint64_t depth,
+                         uint64_t cycles);
+
+    // Only the return probes report the counters
+    inline void TraceNode(size_t depth) {
+        if (!JSON_USDT_ENABLED(print_return)) {
+            return;
+        }
+        ++trace_counters.nodes;
+        if (depth > trace_counters.depth) {
+            trace_counters.depth = depth;
+        }
+    }
+
+    inline void TraceLoadedNode(size_t depth_left) {
+        if (!JSON_USDT_ENABLED(load_return)) {
+            return;
+        }
+        ++trace_counters.nodes;
+        if (depth_left < trace_counters.min_depth_left) {
+            trace_counters.min_depth_left = depth_left;
+        }
+    }
+
+    inline uint64_t TraceClock() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+#endif
+    }
+
+    // Stream position without touching the stream state, -1 when unknown
+    inline std::streamoff StreamPosition(std::streambuf* buf, std::ios_base::openmode which) {
+        return buf == nullptr ? -1 : static_cast<std::streamoff>(buf->pubseekoff(0, std::ios_base::cur, which));
+    }
+
+    // Fires the entry probe on construction and the return probe on destruction,
+    // also when parsing fails. Counters are saved so that nested calls
+    // (embedded documents) don't disturb the outer one. Does nothing unless a
+    // tracer is attached to one of the probes.
+    class TraceScope {
+    public:
+        TraceScope(bool is_load, const void* caller, std::streambuf* buf, size_t max_depth = 0)
+            : is_load_(is_load)
+            , caller_(caller)
+            , buf_(buf)
+            , max_depth_(max_depth) {
+            active_ = is_load_ ? JSON_USDT_ENABLED(load_entry) || JSON_USDT_ENABLED(load_return)
+                               : JSON_USDT_ENABLED(print_entry) || JSON_USDT_ENABLED(print_return);
+            if (!active_) {
+                return;
+            }
+            saved_ = trace_counters;
+            trace_counters = {};
+            position_ = StreamPosition(buf_, is_load_ ? std::ios_base::in : std::ios_base::out);
+            FireEntryProbe(is_load_, caller_);
+            start_ = TraceClock();
+        }
+
+        // For inputs that are not streams
+        void SetBytes(uint64_t bytes) {
+            bytes_ = bytes;
+        }
+
+        TraceScope(const TraceScope&) = delete;
+        TraceScope& operator=(const TraceScope&) = delete;
+
+        ~TraceScope() {
+            if (!active_) {
+                return;
+            }
+            const uint64_t cycles = TraceClock() - start_;
+            const std::streamoff end = StreamPosition(buf_, is_load_ ? std::ios_base::in : std::ios_base::out);
+            const uint64_t bytes = position_ >= 0 && end >= position_ ? end - position_ : bytes_;
+            const uint64_t nodes = trace_counters.nodes;
+            const uint64_t depth = is_load_ && trace_counters.nodes > 0
+                                       ? max_depth_ - trace_counters.min_depth_left
+                                       : trace_counters.depth;
+            FireReturnProbe(is_load_, caller_, bytes, nodes, depth, cycles);
+            trace_counters = saved_;
+        }
+
+    private:
+        bool is_load_;
+        bool active_ = false;
+        const void* caller_;
+        std::streambuf* buf_;
+        size_t max_depth_;
+        TraceCounters saved_;
+        std::streamoff position_ = -1;
+        uint64_t bytes_ = 0;
+        uint64_t start_ = 0;
+    };
+
+#else
+
+    inline void TraceNode(size_t) {
+    }
+
+    inline void TraceLoadedNode(size_t) {
+    }
+
+    class TraceScope {
+    public:
+        TraceScope(bool, const void*, std::streambuf*, size_t = 0) {
+        }
+
+        void SetBytes(uint64_t) {
+        }
+    };
+
+#endif
+
+}  // namespace json::detail
+
+// Return address of the current function, i.e. the call site of Load/Print
+#if defined(__GNUC__)
+#define JSON_CALLER() __builtin_return_address(0)
+#else
+#define JSON_CALLER() nullptr
+#endif
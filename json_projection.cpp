@@ -0,0 +1,296 @@
+#include "json_projection.h"
+#include "json_detail.h"
+#include "json_tokenizer.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace json {
+
+namespace {
+
+// ContentHash is built from these, for the text and for Nodes alike
+const uint64_t kArraySeed = 0x9e3779b97f4a7c15ULL;
+const uint64_t kDictSeed = 0xd1b54a32d192ed03ULL;
+const uint64_t kStringSeed = 0x8cb92ba72f3d8dd7ULL;
+
+uint64_t Mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+uint64_t ScalarHash(const Node& node) {
+    if (node.IsNull()) {
+        return Mix(1);
+    } else if (node.IsBool()) {
+        return Mix(node.AsBool() ? 2 : 3);
+    } else if (node.IsInt()) {
+        return Mix(Mix(static_cast<uint64_t>(static_cast<int64_t>(node.AsInt()))) ^ kArraySeed);
+    } else if (node.IsPureDouble()) {
+        // 0.0 == -0.0 for Nodes
+        const double value = node.AsDouble() == 0 ? 0.0 : node.AsDouble();
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return Mix(Mix(bits) ^ kDictSeed);
+    }
+    return detail::Hash64(node.AsString(), kStringSeed);
+}
+
+// Arrays hash their elements in order, dicts sum their members
+uint64_t AddElement(uint64_t hash, uint64_t element) {
+    return Mix(hash + element);
+}
+
+uint64_t MemberHash(string_view key, uint64_t value) {
+    return Mix(detail::Hash64(key) ^ Mix(value + kDictSeed));
+}
+
+// Sets *duplicate_keys when a dict repeats a key, if asked to
+uint64_t TextHash(detail::BufferSource& src, size_t depth_left, bool* duplicate_keys) {
+    src.SkipWhitespace();
+    const int c = src.Peek();
+    if (c != '[' && c != '{') {
+        if (c == '"') {
+            src.Get();
+            return detail::Hash64(detail::ReadString(src), kStringSeed);
+        } else if (detail::HasClass(c, detail::kDigit) || c == '-') {
+            return ScalarHash(detail::ReadNumber(src));
+        } else if (detail::HasClass(c, detail::kAlpha)) {
+            return ScalarHash(detail::ReadLiteral(src));
+        } else if (c == detail::BufferSource::kEof) {
+            throw ParsingError("Unexpected end of input");
+        }
+        throw ParsingError("Unexpected character: " + string(1, static_cast<char>(c)));
+    }
+
+    const bool is_dict = c == '{';
+    src.Get();
+    if (depth_left == 0) {
+        throw ParsingError("Nesting is too deep");
+    }
+    uint64_t hash = is_dict ? 0 : kArraySeed;
+    size_t count = 0;
+    src.SkipWhitespace();
+    if (src.Peek() == (is_dict ? '}' : ']')) {
+        src.Get();
+    } else {
+        string key;
+        vector<uint64_t> key_hashes;
+        while (true) {
+            if (is_dict) {
+                src.SkipWhitespace();
+                if (src.Get() != '"') {
+                    throw ParsingError("Dict key should start with \"");
+                }
+                key = detail::ReadString(src);
+                src.SkipWhitespace();
+                if (src.Get() != ':') {
+                    throw ParsingError("Expected ':' after dict key");
+                }
+                if (duplicate_keys != nullptr && !*duplicate_keys) {
+                    key_hashes.push_back(detail::Hash64(key));
+                }
+            }
+            const uint64_t value = TextHash(src, depth_left - 1, duplicate_keys);
+            hash = is_dict ? hash + MemberHash(key, value) : AddElement(hash, value);
+            ++count;
+            src.SkipWhitespace();
+            const int next = src.Get();
+            if (next == (is_dict ? '}' : ']')) {
+                break;
+            } else if (next != ',') {
+                throw ParsingError(is_dict ? "Expected ',' or '}' in dict" : "Expected ',' or ']' in array");
+            }
+        }
+        // A hash collision only costs the caller a closer look
+        if (key_hashes.size() > 1) {
+            sort(key_hashes.begin(), key_hashes.end());
+            if (adjacent_find(key_hashes.begin(), key_hashes.end()) != key_hashes.end()) {
+                *duplicate_keys = true;
+            }
+        }
+    }
+    return is_dict ? Mix(kDictSeed ^ hash ^ Mix(count)) : Mix(hash ^ count);
+}
+
+}  // namespace
+
+Projection::Projection(const vector<string>& pointers, size_t max_depth)
+    : size_(pointers.size())
+    , max_depth_(max_depth) {
+    AddStep();
+    for (size_t i = 0; i < pointers.size(); ++i) {
+        size_t step = 0;
+        for (const string& token : detail::SplitPointer(pointers[i])) {
+            auto it = find_if(steps_[step].keys.begin(), steps_[step].keys.end(), [&token](const auto& key) {
+                return key.first == token;
+            });
+            if (it != steps_[step].keys.end()) {
+                step = it->second;
+                continue;
+            }
+            const size_t next = AddStep();
+            steps_[step].keys.emplace_back(token, next);
+            if (optional<size_t> index = detail::IndexToken(token)) {
+                steps_[step].indices.emplace_back(*index, next);
+            }
+            step = next;
+        }
+        steps_[step].targets.push_back(i);
+    }
+}
+
+size_t Projection::Size() const {
+    return size_;
+}
+
+size_t Projection::AddStep() {
+    steps_.emplace_back();
+    return steps_.size() - 1;
+}
+
+void Projection::ExtractRaw(string_view record, vector<string_view>& values) const {
+    values.assign(size_, string_view{});
+    detail::BufferSource src(record.data(), record.data() + record.size());
+    size_t found = 0;
+    if (size_ > 0) {
+        Walk(src, record, 0, max_depth_, values, found);
+    }
+}
+
+vector<string_view> Projection::ExtractRaw(string_view record) const {
+    vector<string_view> values;
+    ExtractRaw(record, values);
+    return values;
+}
+
+vector<optional<Node>> Projection::Extract(string_view record) const {
+    vector<optional<Node>> result(size_);
+    const vector<string_view> values = ExtractRaw(record);
+    for (size_t i = 0; i < size_; ++i) {
+        if (!values[i].empty()) {
+            result[i] = Load(values[i]).GetRoot();
+        }
+    }
+    return result;
+}
+
+// Returns true once every pointer has been found
+bool Projection::Walk(detail::BufferSource& src, string_view record, size_t step, size_t depth_left,
+                      vector<string_view>& values, size_t& found) const {
+    src.SkipWhitespace();
+    const size_t start = src.Position();
+    const Step& current = steps_[step];
+    const int c = src.Peek();
+
+    if (c == '{' && !current.keys.empty()) {
+        src.Get();
+        if (depth_left == 0) {
+            throw ParsingError("Nesting is too deep");
+        }
+        src.SkipWhitespace();
+        if (src.Peek() == '}') {
+            src.Get();
+        } else {
+            while (true) {
+                src.SkipWhitespace();
+                if (src.Get() != '"') {
+                    throw ParsingError("Dict key should start with \"");
+                }
+                const string key = detail::ReadString(src);
+                src.SkipWhitespace();
+                if (src.Get() != ':') {
+                    throw ParsingError("Expected ':' after dict key");
+                }
+                auto it = find_if(current.keys.begin(), current.keys.end(), [&key](const auto& child) {
+                    return child.first == key;
+                });
+                if (it == current.keys.end()) {
+                    detail::SkipValue(src, depth_left - 1);
+                } else if (Walk(src, record, it->second, depth_left - 1, values, found)) {
+                    return true;
+                }
+                src.SkipWhitespace();
+                const int next = src.Get();
+                if (next == '}') {
+                    break;
+                } else if (next != ',') {
+                    throw ParsingError("Expected ',' or '}' in dict");
+                }
+            }
+        }
+    } else if (c == '[' && !current.indices.empty()) {
+        src.Get();
+        if (depth_left == 0) {
+            throw ParsingError("Nesting is too deep");
+        }
+        src.SkipWhitespace();
+        if (src.Peek() == ']') {
+            src.Get();
+        } else {
+            for (size_t index = 0;; ++index) {
+                auto it = find_if(current.indices.begin(), current.indices.end(), [index](const auto& child) {
+                    return child.first == index;
+                });
+                if (it == current.indices.end()) {
+                    detail::SkipValue(src, depth_left - 1);
+                } else if (Walk(src, record, it->second, depth_left - 1, values, found)) {
+                    return true;
+                }
+                src.SkipWhitespace();
+                const int next = src.Get();
+                if (next == ']') {
+                    break;
+                } else if (next != ',') {
+                    throw ParsingError("Expected ',' or ']' in array");
+                }
+            }
+        }
+    } else {
+        detail::SkipValue(src, depth_left);
+    }
+
+    for (size_t target : current.targets) {
+        if (values[target].empty()) {
+            values[target] = record.substr(start, src.Position() - start);
+            ++found;
+        }
+    }
+    return found == size_;
+}
+
+uint64_t ContentHash(string_view text, size_t max_depth) {
+    detail::BufferSource src(text.data(), text.data() + text.size());
+    return TextHash(src, max_depth, nullptr);
+}
+
+uint64_t ContentHash(string_view text, size_t max_depth, bool& duplicate_keys) {
+    detail::BufferSource src(text.data(), text.data() + text.size());
+    return TextHash(src, max_depth, &duplicate_keys);
+}
+
+uint64_t ContentHash(const Node& node) {
+    if (node.IsArray()) {
+        uint64_t hash = kArraySeed;
+        for (const Node& item : node.AsArray()) {
+            hash = AddElement(hash, ContentHash(item));
+        }
+        return Mix(hash ^ node.AsArray().size());
+    }
+    if (node.IsMap()) {
+        uint64_t hash = 0;
+        for (const auto& [key, value] : node.AsMap()) {
+            hash += MemberHash(key, ContentHash(value));
+        }
+        return Mix(kDictSeed ^ hash ^ Mix(node.AsMap().size()));
+    }
+    return ScalarHash(node);
+}
+
+}  // namespace json
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "json.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace json {
+
+    namespace detail {
+        class BufferSource;
+    }
+
+    // Picks the values at a fixed set of JSON Pointers out of the text of a
+    // record (e.g. an NDJSON line) without building the rest of it: other values
+    // are only checked for syntax. Reading stops as soon as every pointer has
+    // been found, so the rest of the record is not validated then. As with
+    // Load, the first of duplicate keys wins. "*" has no special meaning here.
+    class Projection {
+    public:
+        // Throws std::invalid_argument on a malformed pointer
+        explicit Projection(const std::vector<std::string>& pointers, size_t max_depth = LoadOptions{}.max_depth);
+
+        size_t Size() const;
+
+        // Text of the value at every pointer (a view into record), empty when
+        // there is no such value. Throws ParsingError on malformed records.
+        void ExtractRaw(std::string_view record, std::vector<std::string_view>& values) const;
+        std::vector<std::string_view> ExtractRaw(std::string_view record) const;
+
+        // The same values parsed
+        std::vector<std::optional<Node>> Extract(std::string_view record) const;
+
+    private:
+        struct Step {
+            std::vector<std::pair<std::string, size_t>> keys;
+            std::vector<std::pair<size_t, size_t>> indices;
+            // Indices of the pointers ending here
+            std::vector<size_t> targets;
+        };
+
+        size_t AddStep();
+        bool Walk(detail::BufferSource& src, std::string_view record, size_t step, size_t depth_left,
+                  std::vector<std::string_view>& values, size_t& found) const;
+
+        std::vector<Step> steps_;
+        size_t size_;
+        size_t max_depth_;
+    };
+
+    // Hash of the value a JSON text holds: the same for texts that Load into
+    // equal Nodes whatever their whitespace and member order, and the same as
+    // ContentHash of that Node. Computed from the text without building Nodes;
+    // with duplicate keys all of the members count, not only the first.
+    // Throws ParsingError on malformed text.
+    uint64_t ContentHash(std::string_view text, size_t max_depth = LoadOptions{}.max_depth);
+    // Same, and sets duplicate_keys (leaves it alone otherwise) when a dict of
+    // the text repeats a key, i.e. when equal hashes don't imply equal Nodes
+    uint64_t ContentHash(std::string_view text, size_t max_depth, bool& duplicate_keys);
+    uint64_t ContentHash(const Node& node);
+
+}  // namespace json
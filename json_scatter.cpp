@@ -0,0 +1,188 @@
+#include "json_scatter.h"
+#include "json_detail.h"
+
+#include <cerrno>
+#include <climits>
+#include <system_error>
+
+#ifdef JSON_HAS_IOVEC
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace json {
+
+// Mirrors PrintNode from json.cpp, but collects segments instead of streaming.
+// Generated text goes to a std::string first; segment addresses are resolved
+// once it stops growing.
+class ScatterPrinter {
+public:
+    explicit ScatterPrinter(size_t min_reference_size)
+        : min_reference_size_(min_reference_size == 0 ? 1 : min_reference_size) {
+    }
+
+    ScatterOutput Finish(const Node& root) {
+        PrintNode(root, 0);
+        CloseGenerated();
+
+        ScatterOutput result;
+        result.generated_.assign(generated_.begin(), generated_.end());
+        result.segments_.reserve(pieces_.size());
+        for (const Piece& piece : pieces_) {
+            const char* data = piece.ref ? piece.ref : result.generated_.data() + piece.offset;
+            result.segments_.push_back(Segment{const_cast<char*>(data), piece.len});
+            result.total_size_ += piece.len;
+        }
+        return result;
+    }
+
+private:
+    struct Piece {
+        const char* ref;  // nullptr for generated text
+        size_t offset;
+        size_t len;
+    };
+
+    void CloseGenerated() {
+        if (generated_.size() > run_start_) {
+            pieces_.push_back({nullptr, run_start_, generated_.size() - run_start_});
+            run_start_ = generated_.size();
+        }
+    }
+
+    void Reference(const char* data, size_t len) {
+        CloseGenerated();
+        pieces_.push_back({data, 0, len});
+    }
+
+    void Indent(int indent) {
+        generated_ += '\n';
+        generated_.append(indent, ' ');
+    }
+
+    void PrintString(const string& value) {
+        generated_ += '"';
+        size_t run_begin = 0;
+        auto flush_run = [&](size_t run_end) {
+            size_t len = run_end - run_begin;
+            if (len >= min_reference_size_) {
+                Reference(value.data() + run_begin, len);
+            } else {
+                generated_.append(value, run_begin, len);
+            }
+        };
+        for (size_t i = 0; i < value.size(); ++i) {
+            if (const char* escaped = detail::EscapeSequence(value[i])) {
+                flush_run(i);
+                generated_ += escaped;
+                run_begin = i + 1;
+            }
+        }
+        flush_run(value.size());
+        generated_ += '"';
+    }
+
+    void PrintArray(const Array& array, int indent) {
+        generated_ += '[';
+        bool first = true;
+        for (const auto& node : array) {
+            if (!first) {
+                generated_ += ',';
+            }
+            first = false;
+            Indent(indent + 2);
+            PrintNode(node, indent + 2);
+        }
+        if (!array.empty()) {
+            Indent(indent);
+        }
+        generated_ += ']';
+    }
+
+    void PrintDict(const Dict& dict, int indent) {
+        generated_ += '{';
+        bool first = true;
+        for (const auto& [key, node] : dict) {
+            if (!first) {
+                generated_ += ',';
+            }
+            first = false;
+            Indent(indent + 2);
+            PrintString(key);
+            generated_ += ": ";
+            PrintNode(node, indent + 2);
+        }
+        if (!dict.empty()) {
+            Indent(indent);
+        }
+        generated_ += '}';
+    }
+
+    void PrintNode(const Node& node, int indent) {
+        visit([this, indent](const auto& value) {
+            using T = decay_t<decltype(value)>;
+
+            if constexpr (is_same_v<T, nullptr_t>) {
+                generated_ += "null";
+            } else if constexpr (is_same_v<T, bool>) {
+                generated_ += value ? "true" : "false";
+            } else if constexpr (is_same_v<T, int>) {
+                detail::AppendInt(generated_, value);
+            } else if constexpr (is_same_v<T, double>) {
+                detail::AppendDouble(generated_, value);
+            } else if constexpr (is_same_v<T, string>) {
+                PrintString(value);
+            } else if constexpr (is_same_v<T, Array>) {
+                PrintArray(value, indent);
+            } else if constexpr (is_same_v<T, Dict>) {
+                PrintDict(value, indent);
+            }
+        }, node.GetValue());
+    }
+
+    size_t min_reference_size_;
+    string generated_;
+    size_t run_start_ = 0;
+    vector<Piece> pieces_;
+};
+
+const vector<Segment>& ScatterOutput::GetSegments() const {
+    return segments_;
+}
+
+size_t ScatterOutput::GetTotalSize() const {
+    return total_size_;
+}
+
+#ifdef JSON_HAS_IOVEC
+void ScatterOutput::WriteTo(int fd) const {
+    vector<iovec> pending(segments_.begin(), segments_.end());
+    size_t first = 0;
+    while (first < pending.size()) {
+        int count = static_cast<int>(min<size_t>(pending.size() - first, IOV_MAX));
+        ssize_t written = writev(fd, pending.data() + first, count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw system_error(errno, generic_category(), "writev failed");
+        }
+        size_t left = static_cast<size_t>(written);
+        while (first < pending.size() && left >= pending[first].iov_len) {
+            left -= pending[first].iov_len;
+            ++first;
+        }
+        if (left > 0) {
+            pending[first].iov_base = static_cast<char*>(pending[first].iov_base) + left;
+            pending[first].iov_len -= left;
+        }
+    }
+}
+#endif
+
+ScatterOutput PrintScatter(const Document& doc, size_t min_reference_size) {
+    return ScatterPrinter(min_reference_size).Finish(doc.GetRoot());
+}
+
+}  // namespace json
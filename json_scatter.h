@@ -0,0 +1,59 @@
+#pragma once
+
+#include "json.h"
+
+#include <cstddef>
+#include <vector>
+
+#if __has_include(<sys/uio.h>)
+#include <sys/uio.h>
+#define JSON_HAS_IOVEC 1
+#endif
+
+namespace json {
+
+#ifdef JSON_HAS_IOVEC
+    using Segment = iovec;
+#else
+    struct Segment {
+        void* iov_base;
+        size_t iov_len;
+    };
+#endif
+
+    // Document text as a list of segments ready for writev/pwritev.
+    // Syntax, numbers and escaped text live in a buffer owned by the object,
+    // long strings that need no escaping point straight into the Nodes, so
+    // the printed Document must outlive the segments.
+    class ScatterOutput {
+    public:
+        ScatterOutput() = default;
+        // Segments point into generated_, whose buffer a move hands over as is
+        // but a copy would not
+        ScatterOutput(const ScatterOutput&) = delete;
+        ScatterOutput& operator=(const ScatterOutput&) = delete;
+        ScatterOutput(ScatterOutput&&) = default;
+        ScatterOutput& operator=(ScatterOutput&&) = default;
+
+        const std::vector<Segment>& GetSegments() const;
+        size_t GetTotalSize() const;
+
+#ifdef JSON_HAS_IOVEC
+        // Writes every segment to fd, batching by IOV_MAX and resuming after
+        // partial writes. Throws std::system_error on failure.
+        void WriteTo(int fd) const;
+#endif
+
+    private:
+        friend class ScatterPrinter;
+
+        std::vector<char> generated_;
+        std::vector<Segment> segments_;
+        size_t total_size_ = 0;
+    };
+
+    // Strings (and unescaped runs inside strings) of at least min_reference_size
+    // bytes are referenced instead of copied
+    ScatterOutput PrintScatter(const Document& doc, size_t min_reference_size = 64);
+
+}  // namespace json
@@ -0,0 +1,161 @@
+#include "json_serializer.h"
+#include "json_detail.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace json {
+
+Serializer::Serializer(const Document& doc) : root_(&doc.GetRoot()) {
+}
+
+bool Serializer::Done() const {
+    return started_ && stack_.empty() && str_ == nullptr && pending_pos_ == pending_.size();
+}
+
+size_t Serializer::Fill(char* buf, size_t cap) {
+    size_t written = 0;
+    while (written < cap) {
+        if (pending_pos_ < pending_.size()) {
+            size_t len = min(cap - written, pending_.size() - pending_pos_);
+            memcpy(buf + written, pending_.data() + pending_pos_, len);
+            pending_pos_ += len;
+            written += len;
+        } else if (str_ != nullptr) {
+            written += FillString(buf + written, cap - written);
+        } else if (!Step()) {
+            break;
+        }
+    }
+    return written;
+}
+
+// Copies unescaped runs of the current string straight into buf. An escape
+// sequence goes to pending_ so that it is never split by the buffer boundary.
+size_t Serializer::FillString(char* buf, size_t cap) {
+    const string& value = *str_;
+    size_t end = str_pos_ + min(cap, value.size() - str_pos_);
+    size_t run_end = str_pos_;
+    while (run_end < end && detail::EscapeSequence(value[run_end]) == nullptr) {
+        ++run_end;
+    }
+    size_t len = run_end - str_pos_;
+    memcpy(buf, value.data() + str_pos_, len);
+    str_pos_ = run_end;
+
+    pending_.clear();
+    pending_pos_ = 0;
+    if (str_pos_ < value.size() && run_end < end) {
+        pending_ += detail::EscapeSequence(value[str_pos_++]);
+    }
+    if (str_pos_ == value.size()) {
+        pending_ += '"';
+        str_ = nullptr;
+    }
+    return len;
+}
+
+void Serializer::NewLine(int indent) {
+    pending_ += '\n';
+    pending_.append(indent, ' ');
+}
+
+void Serializer::BeginString(const string& value) {
+    pending_ += '"';
+    str_ = &value;
+    str_pos_ = 0;
+}
+
+void Serializer::Begin(const Node& node, int indent) {
+    visit([this, indent](const auto& value) {
+        using T = decay_t<decltype(value)>;
+
+        if constexpr (is_same_v<T, nullptr_t>) {
+            pending_ += "null";
+        } else if constexpr (is_same_v<T, bool>) {
+            pending_ += value ? "true" : "false";
+        } else if constexpr (is_same_v<T, int>) {
+            detail::AppendInt(pending_, value);
+        } else if constexpr (is_same_v<T, double>) {
+            detail::AppendDouble(pending_, value);
+        } else if constexpr (is_same_v<T, string>) {
+            BeginString(value);
+        } else if constexpr (is_same_v<T, Array>) {
+            pending_ += '[';
+            Frame frame;
+            frame.array = &value;
+            frame.indent = indent;
+            stack_.push_back(frame);
+        } else if constexpr (is_same_v<T, Dict>) {
+            pending_ += '{';
+            Frame frame;
+            frame.dict = &value;
+            frame.it = value.begin();
+            frame.indent = indent;
+            stack_.push_back(frame);
+        }
+    }, node.GetValue());
+}
+
+// Generates the next piece of output into pending_ (and possibly str_).
+// Returns false when there is nothing left.
+bool Serializer::Step() {
+    pending_.clear();
+    pending_pos_ = 0;
+
+    if (!started_) {
+        started_ = true;
+        Begin(*root_, 0);
+        return true;
+    }
+    if (stack_.empty()) {
+        return false;
+    }
+
+    Frame& frame = stack_.back();
+    const int indent = frame.indent;
+    if (frame.array != nullptr) {
+        const Array& array = *frame.array;
+        if (frame.index < array.size()) {
+            if (frame.index > 0) {
+                pending_ += ',';
+            }
+            NewLine(indent + 2);
+            // Begin may push a frame and invalidate the reference
+            const Node& child = array[frame.index++];
+            Begin(child, indent + 2);
+        } else {
+            if (!array.empty()) {
+                NewLine(indent);
+            }
+            pending_ += ']';
+            stack_.pop_back();
+        }
+    } else {
+        const Dict& dict = *frame.dict;
+        if (frame.awaiting_value) {
+            frame.awaiting_value = false;
+            const Node& child = (frame.it++)->second;
+            pending_ += ": ";
+            Begin(child, indent + 2);
+        } else if (frame.it != dict.end()) {
+            if (frame.it != dict.begin()) {
+                pending_ += ',';
+            }
+            NewLine(indent + 2);
+            frame.awaiting_value = true;
+            BeginString(frame.it->first);
+        } else {
+            if (!dict.empty()) {
+                NewLine(indent);
+            }
+            pending_ += '}';
+            stack_.pop_back();
+        }
+    }
+    return true;
+}
+
+}  // namespace json
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "json.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace json {
+
+    // Pull-based serializer: produces the same text as Print, a buffer at a time.
+    // The position in the tree is kept on an explicit stack between calls, so many
+    // documents can be serialized interleaved on one thread. The Document must
+    // stay alive and unchanged until Done().
+    class Serializer {
+    public:
+        explicit Serializer(const Document& doc);
+
+        // Writes up to cap next bytes of the document into buf and returns their
+        // number. Returns 0 only when the whole document has been produced.
+        size_t Fill(char* buf, size_t cap);
+
+        bool Done() const;
+
+    private:
+        struct Frame {
+            const Array* array = nullptr;
+            const Dict* dict = nullptr;
+            size_t index = 0;
+            Dict::const_iterator it;
+            int indent = 0;
+            bool awaiting_value = false;
+        };
+
+        bool Step();
+        void Begin(const Node& node, int indent);
+        void BeginString(const std::string& value);
+        void NewLine(int indent);
+        size_t FillString(char* buf, size_t cap);
+
+        const Node* root_;
+        std::vector<Frame> stack_;
+        std::string pending_;
+        size_t pending_pos_ = 0;
+        const std::string* str_ = nullptr;
+        size_t str_pos_ = 0;
+        bool started_ = false;
+    };
+
+}  // namespace json
@@ -0,0 +1,379 @@
+#pragma once
+
+#include "json.h"
+#include "json_detail.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <ios>
+#include <streambuf>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define JSON_TOKENIZER_SSE2 1
+#endif
+
+// Tokenizer layer shared by every parser (stream, memory, parallel chunks).
+// Character classes come from a table instead of the locale-aware <cctype>
+// functions, whitespace runs and string contents are scanned 16 bytes at a
+// time when the input is in memory, and literals are compared as one word.
+
+namespace json::detail {
+
+    enum CharClass : uint8_t {
+        kSpace = 1,   // the "C" locale isspace set: ' ', '\t', '\n', '\v', '\f', '\r'
+        kDigit = 2,
+        kAlpha = 4,
+        kStringSpecial = 8,  // '"' and '\\'
+    };
+
+    inline constexpr std::array<uint8_t, 256> kCharClasses = [] {
+        std::array<uint8_t, 256> table{};
+        for (unsigned char c : {' ', '\t', '\n', '\v', '\f', '\r'}) {
+            table[c] |= kSpace;
+        }
+        for (int c = '0'; c <= '9'; ++c) {
+            table[c] |= kDigit;
+        }
+        for (int c = 'a'; c <= 'z'; ++c) {
+            table[c] |= kAlpha;
+            table[c - 'a' + 'A'] |= kAlpha;
+        }
+        table['"'] |= kStringSpecial;
+        table['\\'] |= kStringSpecial;
+        return table;
+    }();
+
+    // c is a char or an int_type from a streambuf; EOF belongs to no class
+    inline bool HasClass(int c, CharClass cls) {
+        return c >= -128 && c <= 255 && (kCharClasses[static_cast<unsigned char>(c)] & cls) != 0;
+    }
+
+    // First position in [p, end) that is not whitespace
+    inline const char* SkipWhitespace(const char* p, const char* end) {
+        // Compact JSON rarely has whitespace at all, don't pay for the setup then
+        if (p == end || !HasClass(*p, kSpace)) {
+            return p;
+        }
+#ifdef JSON_TOKENIZER_SSE2
+        const __m128i space = _mm_set1_epi8(' ');
+        const __m128i tab = _mm_set1_epi8('\t');
+        const __m128i four = _mm_set1_epi8(4);
+        for (; end - p >= 16; p += 16) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            // '\t'..'\r' is a contiguous range: c - '\t' <= 4 as unsigned bytes
+            const __m128i shifted = _mm_sub_epi8(chunk, tab);
+            const __m128i in_range = _mm_cmpeq_epi8(_mm_min_epu8(shifted, four), shifted);
+            const __m128i is_space = _mm_or_si128(in_range, _mm_cmpeq_epi8(chunk, space));
+            const unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(is_space)) & 0xFFFF;
+            if (mask != 0) {
+                return p + __builtin_ctz(mask);
+            }
+        }
+#endif
+        while (p != end && HasClass(*p, kSpace)) {
+            ++p;
+        }
+        return p;
+    }
+
+    // First '"' or '\\' in [p, end), or end
+    inline const char* FindStringSpecial(const char* p, const char* end) {
+#ifdef JSON_TOKENIZER_SSE2
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        for (; end - p >= 16; p += 16) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            const __m128i special = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash));
+            const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+            if (mask != 0) {
+                return p + __builtin_ctz(mask);
+            }
+        }
+#endif
+        while (p != end && !HasClass(*p, kStringSpecial)) {
+            ++p;
+        }
+        return p;
+    }
+
+    // Up to 8 characters packed into a word, first character in the low byte
+    inline constexpr uint64_t PackWord(std::string_view text) {
+        uint64_t word = 0;
+        for (size_t i = 0; i < text.size() && i < 8; ++i) {
+            word |= static_cast<uint64_t>(static_cast<unsigned char>(text[i])) << (8 * i);
+        }
+        return word;
+    }
+
+    // Input held in memory
+    class BufferSource {
+    public:
+        static constexpr int kEof = std::char_traits<char>::eof();
+
+        BufferSource(const char* begin, const char* end)
+            : begin_(begin)
+            , p_(begin)
+            , end_(end) {
+        }
+
+        int Peek() const {
+            return p_ == end_ ? kEof : static_cast<unsigned char>(*p_);
+        }
+
+        int Get() {
+            return p_ == end_ ? kEof : static_cast<unsigned char>(*p_++);
+        }
+
+        void SkipWhitespace() {
+            p_ = detail::SkipWhitespace(p_, end_);
+        }
+
+        // Appends characters up to the next '"' or '\\'
+        void AppendStringRun(std::string& out) {
+            const char* run_end = FindStringSpecial(p_, end_);
+            out.append(p_, run_end);
+            p_ = run_end;
+        }
+
+        // Skips characters up to the next '"' or '\\'
+        void SkipStringRun() {
+            p_ = FindStringSpecial(p_, end_);
+        }
+
+        // Consumes a run of letters and returns it packed, 0 when longer than 8
+        uint64_t ReadWord() {
+            const char* start = p_;
+            while (p_ != end_ && HasClass(*p_, kAlpha)) {
+                ++p_;
+            }
+            return p_ - start <= 8 ? PackWord(std::string_view(start, p_ - start)) : 0;
+        }
+
+        size_t Position() const {
+            return p_ - begin_;
+        }
+
+    private:
+        const char* begin_;
+        const char* p_;
+        const char* end_;
+    };
+
+    // Input read through a streambuf directly, without an istream sentry per character
+    class StreamSource {
+    public:
+        static constexpr int kEof = std::char_traits<char>::eof();
+
+        explicit StreamSource(std::streambuf* buf) : buf_(buf) {
+        }
+
+        int Peek() {
+            int c = buf_->sgetc();
+            seen_eof_ |= c == kEof;
+            return c;
+        }
+
+        int Get() {
+            int c = buf_->sbumpc();
+            seen_eof_ |= c == kEof;
+            return c;
+        }
+
+        void SkipWhitespace() {
+            while (HasClass(Peek(), kSpace)) {
+                buf_->sbumpc();
+            }
+        }
+
+        void AppendStringRun(std::string& out) {
+            for (int c = Peek(); c != kEof && !HasClass(c, kStringSpecial); c = buf_->snextc()) {
+                out += static_cast<char>(c);
+            }
+        }
+
+        uint64_t ReadWord() {
+            uint64_t word = 0;
+            size_t length = 0;
+            for (int c = Peek(); HasClass(c, kAlpha); c = buf_->snextc()) {
+                if (length < 8) {
+                    word |= static_cast<uint64_t>(static_cast<unsigned char>(c)) << (8 * length);
+                }
+                ++length;
+            }
+            return length <= 8 ? word : 0;
+        }
+
+        bool SeenEof() const {
+            return seen_eof_;
+        }
+
+    private:
+        std::streambuf* buf_;
+        bool seen_eof_ = false;
+    };
+
+    // Reads a string after its opening quote
+    template <typename Source>
+    std::string ReadString(Source& src) {
+        std::string result;
+        while (true) {
+            src.AppendStringRun(result);
+            int c = src.Get();
+            if (c == '"') {
+                return result;
+            }
+            if (c != '\\') {
+                throw ParsingError("Unterminated string");
+            }
+            c = src.Get();
+            if (c == Source::kEof) {
+                throw ParsingError("Unterminated string");
+            }
+            result += Unescape(static_cast<char>(c));
+        }
+    }
+
+    // Same checks as ReadString without keeping the characters
+    template <typename Source>
+    void SkipString(Source& src) {
+        while (true) {
+            src.SkipStringRun();
+            int c = src.Get();
+            if (c == '"') {
+                return;
+            }
+            if (c != '\\') {
+                throw ParsingError("Unterminated string");
+            }
+            c = src.Get();
+            if (c == Source::kEof) {
+                throw ParsingError("Unterminated string");
+            }
+            Unescape(static_cast<char>(c));
+        }
+    }
+
+    // -?digits*(.digits*)?([eE][+-]?digits*)?, converted by NumberFromText
+    template <typename Source>
+    Node ReadNumber(Source& src) {
+        char text[64];
+        std::string long_text;
+        size_t length = 0;
+        bool is_double = false;
+        auto take = [&] {
+            char c = static_cast<char>(src.Get());
+            if (length < sizeof(text)) {
+                text[length] = c;
+            } else {
+                if (length == sizeof(text)) {
+                    long_text.assign(text, length);
+                }
+                long_text += c;
+            }
+            ++length;
+        };
+        auto digits = [&] {
+            while (HasClass(src.Peek(), kDigit)) {
+                take();
+            }
+        };
+
+        if (src.Peek() == '-') {
+            take();
+        }
+        digits();
+        if (src.Peek() == '.') {
+            is_double = true;
+            take();
+            digits();
+        }
+        if (src.Peek() == 'e' || src.Peek() == 'E') {
+            is_double = true;
+            take();
+            if (src.Peek() == '+' || src.Peek() == '-') {
+                take();
+            }
+            digits();
+        }
+        return NumberFromText(length <= sizeof(text) ? std::string_view(text, length) : long_text, is_double);
+    }
+
+    // true, false or null, compared as a single word
+    template <typename Source>
+    Node ReadLiteral(Source& src) {
+        constexpr uint64_t kTrue = PackWord("true");
+        constexpr uint64_t kFalse = PackWord("false");
+        constexpr uint64_t kNull = PackWord("null");
+
+        const uint64_t word = src.ReadWord();
+        if (word == kTrue) {
+            return Node(true);
+        } else if (word == kFalse) {
+            return Node(false);
+        } else if (word == kNull) {
+            return Node(nullptr);
+        }
+        std::string token;
+        for (uint64_t w = word; w != 0; w >>= 8) {
+            token += static_cast<char>(w & 0xFF);
+        }
+        throw ParsingError("Unknown token: " + token);
+    }
+
+    // Checks the syntax of a value, with the grammar of LoadNode, without
+    // building it. Leading whitespace is skipped.
+    template <typename Source>
+    void SkipValue(Source& src, size_t depth_left) {
+        src.SkipWhitespace();
+        const int c = src.Peek();
+        if (c == '[' || c == '{') {
+            const int close = c == '[' ? ']' : '}';
+            src.Get();
+            if (depth_left == 0) {
+                throw ParsingError("Nesting is too deep");
+            }
+            src.SkipWhitespace();
+            if (src.Peek() == close) {
+                src.Get();
+                return;
+            }
+            while (true) {
+                if (close == '}') {
+                    src.SkipWhitespace();
+                    if (src.Get() != '"') {
+                        throw ParsingError("Dict key should start with \"");
+                    }
+                    SkipString(src);
+                    src.SkipWhitespace();
+                    if (src.Get() != ':') {
+                        throw ParsingError("Expected ':' after dict key");
+                    }
+                }
+                SkipValue(src, depth_left - 1);
+                src.SkipWhitespace();
+                const int next = src.Get();
+                if (next == close) {
+                    return;
+                } else if (next != ',') {
+                    throw ParsingError(close == ']' ? "Expected ',' or ']' in array" : "Expected ',' or '}' in dict");
+                }
+            }
+        } else if (c == '"') {
+            src.Get();
+            SkipString(src);
+        } else if (HasClass(c, kDigit) || c == '-') {
+            ReadNumber(src);
+        } else if (HasClass(c, kAlpha)) {
+            ReadLiteral(src);
+        } else if (c == Source::kEof) {
+            throw ParsingError("Unexpected end of input");
+        } else {
+            throw ParsingError("Unexpected character: " + std::string(1, static_cast<char>(c)));
+        }
+    }
+
+}  // namespace json::detail
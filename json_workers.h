@@ -0,0 +1,64 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+// Thread helpers shared by the multithreaded parts (LoadParallel, NDJSON
+// readers and scanners). Not part of the public interface.
+
+namespace json::detail {
+
+    // 0 means one thread per core
+    inline unsigned ResolveThreads(unsigned threads) {
+        return threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Calls fn(i) for every i in [0, count) on up to `threads` threads, the
+    // calling one included. When calls throw, the exception of the smallest i
+    // is rethrown after all of them have finished. When a thread can't be
+    // started, the ones already running are stopped and joined and that error
+    // is rethrown.
+    template <typename Fn>
+    void ParallelFor(size_t count, unsigned threads, Fn fn) {
+        std::atomic<size_t> next{0};
+        std::vector<std::exception_ptr> errors(count);
+        auto work = [&] {
+            for (size_t i; (i = next++) < count;) {
+                try {
+                    fn(i);
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            }
+        };
+        std::vector<std::thread> workers;
+        std::exception_ptr start_error;
+        try {
+            for (unsigned t = 1; t < std::min<size_t>(threads, count); ++t) {
+                workers.emplace_back(work);
+            }
+        } catch (...) {
+            start_error = std::current_exception();
+            next = count;
+        }
+        if (!start_error) {
+            work();
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        if (start_error) {
+            std::rethrow_exception(start_error);
+        }
+        for (const std::exception_ptr& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+}  // namespace json::detail
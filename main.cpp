@@ -1,9 +1,28 @@
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <iterator>
 #include <sstream>
 #include <string_view>
+#include <thread>
 
 #include "json.h"
+#include "json_block_gzip.h"
+#include "json_block_stats.h"
+#include "json_dedup.h"
+#include "json_diff.h"
+#include "json_observer.h"
+#include "json_overlay.h"
+#include "json_parallel.h"
+#include "json_path_index.h"
+#include "json_projection.h"
+#include "json_scatter.h"
+#include "json_serializer.h"
 
 using namespace json;
 using namespace std::literals;
@@ -40,6 +59,14 @@ void MustFailToLoad(const std::string& s) {
         std::cerr << "Unexpected error"sv << std::endl;
         assert(false);
     }
+    // Разбор из памяти должен отвергать то же самое
+    try {
+        json::Load(std::string_view(s));
+        std::cerr << "ParsingError exception is expected on '"sv << s << "' in memory"sv << std::endl;
+        assert(false);
+    } catch (const json::ParsingError&) {
+        // ok
+    }
 }
 
 template <typename Fn>
@@ -114,8 +141,24 @@ void TestNumbers() {
     assert(LoadJSON("1.2e-5"s).GetRoot().AsDouble() == 1.2e-5);
     assert(LoadJSON("1.2e+5"s).GetRoot().AsDouble() == 1.2e5);
     assert(LoadJSON("-123456"s).GetRoot().AsInt() == -123456);
+    // Не помещающиеся в int целые читаются как double
+    assert(LoadJSON("12345678901"s).GetRoot() == Node{12345678901.0});
     assert(LoadJSON("0").GetRoot() == Node{0});
     assert(LoadJSON("0.0").GetRoot() == Node{0.0});
+    // Слишком близкие к нулю числа читаются как ноль своего знака, слишком большие - ошибка
+    const Node tiny = LoadJSON("1e-400"s).GetRoot();
+    assert(tiny.IsPureDouble() && tiny.AsDouble() == 0.0 && !std::signbit(tiny.AsDouble()));
+    const Node negative_tiny = Load("-0.0001e-400"sv).GetRoot();
+    assert(negative_tiny.AsDouble() == 0.0 && std::signbit(negative_tiny.AsDouble()));
+    assert(Load("[-1e-400]"sv).GetRoot().AsArray().at(0).AsDouble() == 0.0);
+    for (const std::string_view huge : {"1e400"sv, "-1e400"sv, "0.1e310"sv}) {
+        try {
+            Load(huge);
+            assert(false);
+        } catch (const ParsingError&) {
+            // ok
+        }
+    }
     // Пробелы, табуляции и символы перевода строки между токенами JSON файла игнорируются
     assert(LoadJSON(" \t\r\n\n\r 0.0 \t\r\n\n\r ").GetRoot() == Node{0.0});
 }
@@ -159,7 +202,7 @@ void TestBool() {
 }
 
 void TestArray() {
-    Node arr_node{Array{1, 1.23, "Hello"s}};
+    Node arr_node{Array{Node{1}, Node{1.23}, Node{"Hello"s}}};
     assert(arr_node.IsArray());
     const Array& arr = arr_node.AsArray();
     assert(arr.size() == 3);
@@ -174,7 +217,7 @@ void TestArray() {
 }
 
 void TestMap() {
-    Node dict_node{Dict{{"key1"s, "value1"s}, {"key2"s, 42}}};
+    Node dict_node{Dict{{"key1"s, Node{"value1"s}}, {"key2"s, Node{42}}}};
     assert(dict_node.IsMap());
     const Dict& dict = dict_node.AsMap();
     assert(dict.size() == 2);
@@ -204,6 +247,10 @@ void TestErrorHandling() {
     MustFailToLoad("fals"s);
     MustFailToLoad("nul"s);
 
+    MustFailToLoad("-"s);
+    MustFailToLoad("1e999"s);
+    MustFailToLoad(std::string(10'000, '[') + std::string(10'000, ']'));
+
     Node dbl_node{3.5};
     MustThrowLogicError([&dbl_node] {
         dbl_node.AsInt();
@@ -227,19 +274,554 @@ void TestErrorHandling() {
     });
 }
 
+void TestScatter() {
+    const std::string big(1000, 'x');
+    Array arr;
+    arr.emplace_back(big);
+    arr.emplace_back("line\n"s + big);
+    arr.emplace_back(Dict{{"key"s, Node{42}}, {"short"s, Node{"abc"s}}});
+    const Document doc{arr};
+
+    std::ostringstream out;
+    json::Print(doc, out);
+
+    const ScatterOutput scatter = PrintScatter(doc);
+    std::string joined;
+    for (const Segment& segment : scatter.GetSegments()) {
+        joined.append(static_cast<const char*>(segment.iov_base), segment.iov_len);
+    }
+    assert(joined == out.str());
+    assert(scatter.GetTotalSize() == joined.size());
+    // Длинная строка без экранирования не копируется
+    assert(scatter.GetSegments().at(1).iov_base == doc.GetRoot().AsArray().at(0).AsString().data());
+}
+
+void TestEmbeddedJson() {
+    Document doc{Node{"{\"id\": 7, \"tags\": [\"a\"]}"s}};
+    const Node& inner = doc.GetEmbedded(doc.GetRoot());
+    assert(inner.AsMap().at("id"s).AsInt() == 7);
+    // Результат кэшируется в документе, узел остаётся обычной строкой
+    assert(&doc.GetEmbedded(doc.GetRoot()) == &inner);
+    static_assert(sizeof(Node) == sizeof(Node::Value));
+    assert(std::holds_alternative<std::string>(doc.GetRoot().GetValue()));
+    assert(ParseEmbedded(doc.GetRoot()).GetRoot() == inner);
+    MustThrowLogicError([] {
+        ParseEmbedded(Node{42});
+    });
+    MustThrowLogicError([&doc] {
+        doc.GetEmbedded(Node{42});
+    });
+
+    // Перемещение сохраняет кэш, копия разбирает строку заново
+    Document moved = std::move(doc);
+    assert(&moved.GetEmbedded(moved.GetRoot()) == &inner);
+    const Document copy = moved;
+    assert(copy.GetEmbedded(copy.GetRoot()) == inner && &copy.GetEmbedded(copy.GetRoot()) != &inner);
+
+    // Первые обращения из нескольких потоков получают один и тот же разбор
+    const Document shared{Node{"[1, 2, 3]"s}};
+    std::vector<const Node*> parsed(4);
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < parsed.size(); ++i) {
+        readers.emplace_back([&shared, &parsed, i] {
+            parsed[i] = &shared.GetEmbedded(shared.GetRoot());
+        });
+    }
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+    assert(std::all_of(parsed.begin(), parsed.end(), [&parsed](const Node* node) {
+        return node == parsed[0] && node->AsArray().size() == 3;
+    }));
+
+    json::LoadOptions options;
+    options.embedded_json_paths = {"/events/*/payload"s};
+    std::istringstream strm(R"({"events": [{"payload": "[1, 2]"}, {"payload": "null"}]})"s);
+    Document loaded = json::Load(strm, options);
+    const Array& events = loaded.GetRoot().AsMap().at("events"s).AsArray();
+    assert(loaded.GetEmbedded(events.at(0).AsMap().at("payload"s)).AsArray().size() == 2);
+    assert(loaded.GetEmbedded(events.at(1).AsMap().at("payload"s)).IsNull());
+    // Изменение документа сбрасывает таблицу
+    loaded.Set("/events/0/payload"sv, Node{"{}"s});
+    assert(loaded.GetEmbedded(loaded.GetRoot().AsMap().at("events"s).AsArray().at(0).AsMap().at("payload"s)).IsMap());
+}
+
+void TestSerializer() {
+    Dict dict;
+    dict.emplace("escaped"s, Node{"a\"b\\c\n\t"s});
+    dict.emplace("empty"s, Node{Array{}});
+    dict.emplace("nested"s, Node{Array{Node{1}, Node{Dict{}}, Node{2.5}, Node{nullptr}, Node{true}}});
+    const Document doc{dict};
+    const std::string expected = Print(doc.GetRoot());
+
+    // Результат не зависит от размера буфера
+    for (size_t cap : {1, 2, 7, 4096}) {
+        Serializer serializer(doc);
+        std::string result;
+        std::vector<char> buf(cap);
+        while (size_t len = serializer.Fill(buf.data(), cap)) {
+            assert(len <= cap);
+            result.append(buf.data(), len);
+        }
+        assert(serializer.Done());
+        assert(result == expected);
+    }
+}
+
+void TestPathIndex() {
+    std::istringstream strm(R"({"a": {"b/c": [10, {"d": null}]}, "e~": true})"s);
+    const Document doc = json::Load(strm);
+    const PathIndex index(doc);
+    assert(index.Size() == 7);
+    assert(index.Find(""sv) == &doc.GetRoot());
+    assert(index.Find("/a/b~1c/0"sv)->AsInt() == 10);
+    assert(index.Find("/a/b~1c/1/d"sv)->IsNull());
+    assert(index.Find("/e~0"sv)->AsBool());
+    assert(index.Find("/a/b~1c/2"sv) == nullptr);
+
+    PathIndex partial(doc, {"/a/b~1c"s});
+    assert(partial.Size() == 4);
+    assert(partial.Find("/a"sv) == nullptr);
+    partial.Rebuild("/a/b~1c/1"sv);
+    assert(partial.Size() == 4);
+    assert(partial.Find("/a/b~1c/1/d"sv)->IsNull());
+}
+
+void TestDocumentMutation() {
+    Document doc{Dict{}};
+    assert(!doc.Set("/list"sv, Node{Array{}}));
+    assert(!doc.Set("/list/-"sv, Node{1}));
+    assert(!doc.Set("/list/1"sv, Node{2}));
+    assert(doc.Set("/list/0"sv, Node{10})->AsInt() == 1);
+    assert((doc.GetRoot().AsMap().at("list"s) == Array{Node{10}, Node{2}}));
+    assert(doc.Erase("/list/0"sv)->AsInt() == 10);
+    assert(!doc.Erase("/missing"sv));
+    MustThrowLogicError([&doc] {
+        doc.Set("/missing/key"sv, Node{nullptr});
+    });
+}
+
+void TestObservedDocument() {
+    ObservedDocument doc{Document{Dict{}}};
+    std::vector<Change> changes;
+    std::vector<Change> other;
+    doc.Subscribe("/users/*/name"sv, [&changes](const std::vector<Change>& batch) {
+        changes.insert(changes.end(), batch.begin(), batch.end());
+    });
+    doc.Subscribe("/other"sv, [&other](const std::vector<Change>& batch) {
+        other.insert(other.end(), batch.begin(), batch.end());
+    });
+
+    doc.Set("/users"sv, Node{Array{}});
+    doc.Set("/users/-"sv, Node{Dict{{"name"s, Node{"Ann"s}}}});
+    doc.Set("/users/0/name"sv, Node{"Bob"s});
+    doc.Set("/users/0/age"sv, Node{30});
+    doc.Erase("/users/0"sv);
+    doc.Flush();
+
+    assert(other.empty());
+    // "/users/0/age" не подходит под шаблон
+    assert(changes.size() == 4);
+    assert(changes[1].path == "/users/0"s && !changes[1].old_value);
+    assert(changes[2].old_value->AsString() == "Ann"s);
+    assert(changes[2].new_value->AsString() == "Bob"s);
+    assert(!changes[3].new_value);
+
+    // После Unsubscribe слушатель больше не работает, даже если пакет уже
+    // доставлялся в момент вызова
+    std::atomic<bool> started = false;
+    std::atomic<bool> finished = false;
+    const uint64_t slow = doc.Subscribe("/slow"sv, [&started, &finished](const std::vector<Change>&) {
+        started = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        finished = true;
+    });
+    doc.Set("/slow"sv, Node{1});
+    while (!started) {
+        std::this_thread::yield();
+    }
+    doc.Unsubscribe(slow);
+    assert(finished);
+}
+
+void TestLoadParallel() {
+    const std::string text
+        = R"({"a": {"b": [1, 2.5, "x\"]{,", null], "c": {"d": true}}, "e": [[], {}, "\\"], "f": -7})"s;
+    const Node expected = LoadJSON(text).GetRoot();
+    // Мелкие чанки, чтобы границы попадали внутрь строк, чисел и вложенных объектов
+    for (size_t chunk : {1, 3, 16, 1024}) {
+        ParallelLoadOptions options;
+        options.threads = 4;
+        options.min_chunk_size = chunk;
+        assert(LoadParallel(text, options).GetRoot() == expected);
+
+        for (const std::string& bad : {"[1, 2"s, R"({"a" 1})"s, "[1] 2"s, "\"abc"s}) {
+            try {
+                LoadParallel(bad, options);
+                assert(false);
+            } catch (const ParsingError&) {
+                // ok
+            }
+        }
+    }
+}
+
+void TestBlockGzip() {
+    std::vector<Node> records;
+    std::ostringstream data;
+    BlockGzipOptions options;
+    options.block_size = 256;  // много маленьких блоков
+    BlockGzipWriter writer(data, options);
+    for (int i = 0; i < 1'000; ++i) {
+        records.push_back(Node{Dict{{"id"s, Node{i}}, {"text"s, Node{"line\n"s + std::to_string(i)}}}});
+        writer.Write(Document{records.back()});
+    }
+    writer.WriteRaw(R"({"id": 1000})"sv);
+    records.push_back(Node{Dict{{"id"s, Node{1'000}}}});
+
+    std::stringstream index_text;
+    SaveBlockIndex(writer.Finish(), index_text);
+    const BlockIndex index = LoadBlockIndex(index_text);
+    assert(index.size() > 10);
+
+    const std::string file = data.str();
+    const BlockGzipReader reader(file, index);
+    assert(reader.RecordCount() == 1'001);
+
+    BlockGzipReadOptions read_options;
+    read_options.threads = 4;
+    const std::vector<Document> all = reader.ReadAll(read_options);
+    assert(all.size() == records.size());
+    for (size_t i = 0; i < all.size(); ++i) {
+        assert(all[i].GetRoot() == records[i]);
+    }
+
+    // Диапазон внутри файла и диапазон, выходящий за его конец
+    const std::vector<Document> range = reader.Read(123, 77, read_options);
+    assert(range.size() == 77 && range.front().GetRoot() == records[123] && range.back().GetRoot() == records[199]);
+    assert(reader.Read(990, 100).size() == 11);
+    assert(reader.Read(2'000, 10).empty());
+
+    std::string corrupt = file;
+    corrupt[index[1].offset + 20] ^= 0x55;
+    try {
+        BlockGzipReader(corrupt, index).Read(0, 1'001);
+        assert(false);
+    } catch (const ParsingError&) {
+        // ok
+    }
+
+    // Размер из индекса не должен заставить выделить лишнюю память: больше,
+    // чем может дать deflate, отвергается сразу, иной размер - после распаковки
+    BlockIndex inflated = index;
+    inflated[0].uncompressed_size = inflated[0].compressed_size * 2'000;
+    try {
+        BlockGzipReader(file, inflated);
+        assert(false);
+    } catch (const std::invalid_argument&) {
+        // ok
+    }
+    std::stringstream inflated_text;
+    SaveBlockIndex(inflated, inflated_text);
+    try {
+        LoadBlockIndex(inflated_text);
+        assert(false);
+    } catch (const ParsingError&) {
+        // ok
+    }
+    for (int64_t delta : {-1, 1}) {
+        BlockIndex resized = index;
+        resized[0].uncompressed_size += delta;
+        try {
+            BlockGzipReader(file, resized).Decompress(0);
+            assert(false);
+        } catch (const ParsingError&) {
+            // ok
+        }
+    }
+}
+
+void TestProjection() {
+    const Projection projection({"/id"s, "/user/name"s, "/tags/1"s, "/missing"s, "/user"s});
+    const std::string record = R"({"skip": [1, {"x": "}"}], "user": {"name": "Ann", "age": 30}, "id": 7, "tags": ["a", "b"]})"s;
+    const std::vector<std::string_view> raw = projection.ExtractRaw(record);
+    assert(raw[0] == "7"sv);
+    assert(raw[1] == "\"Ann\""sv);
+    assert(raw[2] == "\"b\""sv);
+    assert(raw[3].empty());
+    assert(raw[4] == R"({"name": "Ann", "age": 30})"sv);
+
+    const std::vector<std::optional<Node>> values = projection.Extract(record);
+    assert(values[1] == Node{"Ann"s});
+    assert(!values[3].has_value());
+
+    // Первый из повторяющихся ключей, как в Load
+    assert(Projection({"/a"s}).ExtractRaw(R"({"a": 1, "a": 2})"sv)[0] == "1"sv);
+    // Хеш содержимого не зависит от пробелов и порядка ключей
+    const std::string text = R"({"b": [1, 2.5, "x"], "a": {"n": null, "t": true}})"s;
+    assert(ContentHash(text) == ContentHash(R"({"a":{"t":true,"n":null},"b":[1,2.5,"x"]})"sv));
+    assert(ContentHash(text) == ContentHash(LoadJSON(text).GetRoot()));
+    assert(ContentHash(text) != ContentHash(R"({"b": [2.5, 1, "x"], "a": {"n": null, "t": true}})"sv));
+    assert(ContentHash("1"sv) != ContentHash("1.0"sv));
+
+    try {
+        projection.ExtractRaw(R"({"skip": [1, }, "id": 1})"sv);
+        assert(false);
+    } catch (const ParsingError&) {
+        // ok
+    }
+}
+
+void TestBlockStats() {
+    std::string text;
+    for (int i = 0; i < 2'000; ++i) {
+        text += R"({"ts": )"s + std::to_string(1'000'000 + i) + R"(, "user": "u)"s + std::to_string(i % 50)
+                + R"(", "n": )"s + std::to_string(i) + "}\n"s;
+    }
+    BlockStatsOptions options;
+    options.numeric_paths = {"/ts"s};
+    options.string_paths = {"/user"s};
+    options.block_size = 1'000;
+    options.threads = 4;
+
+    // Индекс переживает сохранение и загрузку
+    std::stringstream sidecar;
+    SaveBlockStats(BuildBlockStats(text, options), sidecar);
+    const BlockStatsIndex index = LoadBlockStats(sidecar);
+    assert(index.blocks.size() > 50);
+    assert(index.blocks.front().numbers[0].min == 1'000'000);
+
+    ScanFilter filter;
+    filter.ranges.push_back({"/ts"s, 1'000'100, 1'000'199});
+    ScanResult result = Scan(text, index, filter);
+    assert(result.records.size() == 100);
+    assert(result.records.front().GetRoot().AsMap().at("n"s).AsInt() == 100);
+    assert(result.blocks_skipped > result.blocks_scanned * 10);
+
+    filter.equals.push_back({"/user"s, "u7"s});
+    result = Scan(text, index, filter);
+    assert(result.records.size() == 2);
+
+    // Условие по пути без статистики ничего не отсекает, но проверяется
+    ScanFilter by_n;
+    by_n.ranges.push_back({"/n"s, 5, 5});
+    result = Scan(text, index, by_n);
+    assert(result.records.size() == 1 && result.blocks_skipped == 0);
+
+    // Строки из одних пробелов записей не содержат, как и пустые
+    const std::string blank = "   \n"s + text + "\t \r\n"s;
+    const BlockStatsIndex blank_index = BuildBlockStats(blank, options);
+    assert(Scan(blank, blank_index, filter).records.size() == 2);
+
+    // Доля ложных срабатываний должна лежать в (0, 1)
+    for (double rate : {0.0, 1.0, -0.5, std::nan("")}) {
+        options.false_positive_rate = rate;
+        try {
+            BuildBlockStats(text, options);
+            assert(false);
+        } catch (const std::invalid_argument&) {
+            // ok
+        }
+    }
+}
+
+void TestOverlayDocument() {
+    const std::string snapshot
+        = R"({"users": [{"name": "a", "age": 1}, {"name": "b", "age": 2}], "meta": {"v": 1, "s": "x"},)"
+          R"( "keep": {"a" :  [1,  2.5]}, "n": null})"s;
+    OverlayDocument doc = OverlayDocument::FromText(snapshot);
+    assert(doc.Find("/users/1/name"sv)->AsString() == "b"s);
+    assert(doc.Find("/keep/a/1"sv)->AsDouble() == 2.5);
+    assert(doc.Find("/n"sv)->IsNull());
+    assert(!doc.Find("/users/5"sv));
+
+    assert(doc.Set("/users/1/name"sv, Node{"B"s})->AsString() == "b"s);
+    assert(doc.Find("/users/1/name"sv)->AsString() == "B"s);
+    assert(doc.Find("/users/1/age"sv)->AsInt() == 2);
+    assert(!doc.Set("/meta/new"sv, Node{5}));
+    assert(doc.Erase("/meta/s"sv)->AsString() == "x"s);
+    assert((doc.Find("/meta"sv)->Keys() == std::vector{"new"s, "v"s}));
+    assert(!doc.Set("/users/-"sv, Node{Dict{}}));
+    assert(doc.GetRoot().At("users"s).Size() == 3);
+    assert(doc.PatchCount() == 4);  // в куче только новый элемент users, не весь массив
+    try {
+        doc.Set("/missing/x"sv, Node{1});
+        assert(false);
+    } catch (const std::out_of_range&) {
+        // ok
+    }
+
+    const Node expected = LoadJSON(
+        R"({"users": [{"name": "a", "age": 1}, {"name": "B", "age": 2}, {}], "meta": {"v": 1, "new": 5},)"
+        R"( "keep": {"a": [1, 2.5]}, "n": null})"s).GetRoot();
+    assert(doc.GetRoot().ToNode() == expected);
+
+    // Новый снимок: нетронутые поддеревья копируются как есть, изменения после
+    // запуска сброса в него не попадают
+    const std::string path = "overlay_test.json"s;
+    std::future<void> flushed = doc.FlushAsync(path);
+    doc.Set("/n"sv, Node{true});
+    flushed.get();
+    const OverlayDocument reopened(path);
+    assert(reopened.GetRoot().ToNode() == expected);
+    std::ifstream file(path);
+    const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    assert(text.find(R"({"a" :  [1,  2.5]})"sv) != std::string::npos);
+    std::remove(path.c_str());
+
+    // Элементы массива добавляются и удаляются по одному; индексы с ведущими
+    // нулями не принимаются (RFC 6901); прежние значения читаются из снимка
+    // лениво и переживают последующие изменения
+    OverlayDocument list = OverlayDocument::FromText(R"({"a": [10, 11, {"x": 12}, 13]})"s);
+    assert(!list.Find("/a/02"sv));
+    try {
+        list.Set("/a/03"sv, Node{99});
+        assert(false);
+    } catch (const std::out_of_range&) {
+        // ok
+    }
+    assert(!list.Set("/a/-"sv, Node{14}));
+    const std::optional<OverlayView> removed = list.Erase("/a/2"sv);
+    assert(list.Set("/a/2"sv, Node{15})->AsInt() == 13);
+    assert(list.Erase("/a/0"sv)->AsInt() == 10);
+    assert(list.Set("/a/2"sv, Node{16})->AsInt() == 14);
+    assert(!list.Set("/a/3"sv, Node{17}));
+    assert(removed->At("x"s).AsInt() == 12);
+    assert(list.PatchCount() == 5);
+    const Node merged = LoadJSON(R"({"a": [11, 15, 16, 17]})"s).GetRoot();
+    assert(list.GetRoot().ToNode() == merged);
+    const std::optional<OverlayView> old_root = list.Erase(""sv);
+    assert(list.GetRoot().IsNull());
+    assert(old_root->ToNode() == merged);
+}
+
+void TestDiff() {
+    const Node patch = DiffNodes(LoadJSON(R"({"a": 1, "b": [1, 2, 3], "c": "x"})"s).GetRoot(),
+                                 LoadJSON(R"({"a": 2, "b": [1, 5], "d": true})"s).GetRoot());
+    assert(patch == LoadJSON(R"([{"op": "replace", "path": "/a", "value": 2},
+                                 {"op": "replace", "path": "/b/1", "value": 5},
+                                 {"op": "remove", "path": "/b/2"},
+                                 {"op": "remove", "path": "/c"},
+                                 {"op": "add", "path": "/d", "value": true}])"s).GetRoot());
+
+    const std::string from = "{\"id\": 1}\n{\"id\": 2, \"v\": 1}\n{\"id\": 3, \"v\": [1, 2]}\n"
+                             "{\"id\": 4}\n{\"id\": 5}\n"s;
+    // строки из одних пробелов пропускаются
+    const std::string to = "{\"id\": 2, \"v\": 2}\n{\"v\":[1,2],\"id\":3}\n \t\n{\"id\": 4}\n{\"id\": 6}\n"s;
+    DiffOptions options;
+    options.batch_size = 10;  // несколько пакетов с каждой стороны
+    options.threads = 2;
+    std::vector<std::pair<RecordDiff::Kind, int>> diffs;
+    const DiffStats stats = DiffSortedNdjson(from, to, [&diffs](const RecordDiff& diff) {
+        diffs.emplace_back(diff.kind, diff.key.AsInt());
+    }, options);
+    assert(stats.added == 1 && stats.removed == 2 && stats.changed == 1 && stats.unchanged == 2);
+    assert((diffs == std::vector<std::pair<RecordDiff::Kind, int>>{
+        {RecordDiff::Kind::kRemoved, 1}, {RecordDiff::Kind::kChanged, 2},
+        {RecordDiff::Kind::kRemoved, 5}, {RecordDiff::Kind::kAdded, 6}}));
+
+    // Повторный ключ меняет ContentHash, но не Node: запись не изменилась
+    const DiffStats duplicates = DiffSortedNdjson("{\"id\": 1, \"v\": 1}\n"sv,
+                                                  "{\"id\": 1, \"v\": 1, \"v\": 2}\n"sv,
+                                                  [](const RecordDiff&) { assert(false); }, options);
+    assert(duplicates.changed == 0 && duplicates.unchanged == 1);
+
+    // Повторные ключи в другом порядке дают тот же ContentHash, но Load
+    // оставляет первый ключ: запись изменилась
+    std::vector<Node> patches;
+    const DiffStats reordered = DiffSortedNdjson("{\"id\": 1, \"a\": 1, \"a\": 2}\n"sv,
+                                                 "{\"id\": 1, \"a\": 2, \"a\": 1}\n"sv,
+                                                 [&patches](const RecordDiff& diff) { patches.push_back(diff.patch); },
+                                                 options);
+    assert(reordered.changed == 1 && patches.size() == 1);
+    assert(patches[0] == LoadJSON(R"([{"op": "replace", "path": "/a", "value": 2}])"s).GetRoot());
+
+    std::ostringstream out;
+    DiffSortedNdjson(from, to, out, options);
+    assert(out.str().find(R"({"key":2,"op":"changed","patch":[{"op":"replace","path":"/v","value":2}]})"sv)
+           != std::string::npos);
+
+    try {
+        DiffSortedNdjson("{\"id\": 2}\n{\"id\": 1}\n"sv, to, [](const RecordDiff&) {});
+        assert(false);
+    } catch (const ParsingError&) {
+        // ok
+    }
+}
+
+void TestDedup() {
+    const std::string text = "{\"id\": 1, \"v\": 1}\n{\"id\": 2}\n{\"v\": 1, \"id\": 1}\n\n  \t\r\n"
+                             "{\"id\": 1, \"v\": 2}\n{\"v\": 3}\n{\"id\": \"1\"}\n"s;
+    DedupOptions options;
+    options.batch_size = 16;  // несколько пакетов
+    options.threads = 2;
+
+    // По содержимому: пробелы и порядок полей не важны
+    std::ostringstream out;
+    DedupStats stats = DeduplicateNdjson(text, out, options);
+    assert(stats.records == 6 && stats.unique == 5 && stats.duplicates == 1 && !stats.degraded);
+    assert(out.str().find("{\"v\": 1, \"id\": 1}"sv) == std::string::npos);
+
+    // По ключу: запись без ключа пропускается без проверки, 1 и "1" - разные ключи
+    options.key_path = "/id"s;
+    std::vector<std::string_view> kept;
+    stats = DeduplicateNdjson(text, [&kept](std::string_view record) {
+        kept.push_back(record);
+    }, options);
+    assert(stats.records == 6 && stats.unique == 3 && stats.duplicates == 2 && stats.without_key == 1);
+    assert((kept == std::vector<std::string_view>{"{\"id\": 1, \"v\": 1}"sv, "{\"id\": 2}"sv, "{\"v\": 3}"sv,
+                                                  "{\"id\": \"1\"}"sv}));
+
+    // Ошибка сообщает номер строки, пустые строки тоже считаются
+    try {
+        DeduplicateNdjson("{\"id\": 1}\n   \n{\"id\": }\n"sv, [](std::string_view) {}, options);
+        assert(false);
+    } catch (const ParsingError& e) {
+        assert(std::string_view(e.what()).substr(0, 7) == "line 3:"sv);
+    }
+
+    // Под нехваткой памяти точное множество заменяется фильтром; фильтр
+    // занимает не больше половины предела, чтобы при переносе оба в нём уместились
+    options.memory_limit = 8192;
+    Deduplicator dedup(options);
+    int kept_count = 0;
+    for (int i = 0; i < 1000; ++i) {
+        kept_count += dedup.Add("{\"id\": "s + std::to_string(i) + "}"s) ? 1 : 0;
+    }
+    // Ложные срабатывания фильтра возможны, но редки
+    assert(dedup.GetStats().degraded && dedup.MemoryUsage() <= options.memory_limit / 2);
+    assert(kept_count > 990 && dedup.GetStats().unique == static_cast<uint64_t>(kept_count));
+    int found = 0;
+    for (int i = 0; i < 1000; ++i) {
+        found += dedup.Add("{\"id\": "s + std::to_string(i) + "}"s) ? 0 : 1;
+    }
+    assert(found == 1000 && dedup.GetStats().probable_duplicates == 1000 - dedup.GetStats().duplicates);
+
+    // Переполненный фильтр пропускает записи без проверки
+    CuckooFilter filter(8);
+    size_t inserted = 0;
+    for (uint64_t i = 0; i < 100; ++i) {
+        inserted += filter.Insert(i * 0x9e3779b97f4a7c15ULL) ? 1 : 0;
+    }
+    assert(inserted >= 8 && inserted < 100 && filter.Size() == inserted);
+    for (uint64_t i = 0; i < inserted; ++i) {
+        assert(filter.MayContain(i * 0x9e3779b97f4a7c15ULL));
+    }
+}
+
 void Benchmark() {
     const auto start = std::chrono::steady_clock::now();
     Array arr;
     arr.reserve(1'000);
     for (int i = 0; i < 1'000; ++i) {
         arr.emplace_back(Dict{
-            {"int"s, 42},
-            {"double"s, 42.1},
-            {"null"s, nullptr},
-            {"string"s, "hello"s},
-            {"array"s, Array{1, 2, 3}},
-            {"bool"s, true},
-            {"map"s, Dict{{"key"s, "value"s}}},
+            {"int"s, Node{42}},
+            {"double"s, Node{42.1}},
+            {"null"s, Node{nullptr}},
+            {"string"s, Node{"hello"s}},
+            {"array"s, Node{Array{Node{1}, Node{2}, Node{3}}}},
+            {"bool"s, Node{true}},
+            {"map"s, Node{Dict{{"key"s, Node{"value"s}}}}},
         });
     }
     std::stringstream strm;
@@ -251,6 +833,78 @@ void Benchmark() {
               << std::endl;
 }
 
+// Разбор текста с глубокими отступами, где большая часть байтов - пробелы
+void BenchmarkIndented() {
+    Array arr;
+    for (int i = 0; i < 20'000; ++i) {
+        Node leaf{Dict{{"id"s, Node{i}}, {"ok"s, Node{true}}, {"none"s, Node{nullptr}}, {"name"s, Node{"item"s}}}};
+        for (int level = 0; level < 6; ++level) {
+            leaf = Node{Dict{{"level"s, Node{Array{std::move(leaf), Node{false}}}}}};
+        }
+        arr.push_back(std::move(leaf));
+    }
+    std::ostringstream out;
+    json::Print(Document{arr}, out);
+    const std::string text = out.str();
+
+    auto start = std::chrono::steady_clock::now();
+    std::istringstream input(text);
+    const Document from_stream = json::Load(input);
+    const auto stream_duration = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    const Document from_memory = json::Load(std::string_view(text));
+    const auto memory_duration = std::chrono::steady_clock::now() - start;
+
+    assert(from_stream.GetRoot() == arr);
+    assert(from_memory.GetRoot() == arr);
+    std::cout << "indented "sv << text.size() / 1'000'000 << "MB: istream "sv
+              << std::chrono::duration_cast<std::chrono::milliseconds>(stream_duration).count() << "ms, memory "sv
+              << std::chrono::duration_cast<std::chrono::milliseconds>(memory_duration).count() << "ms"sv
+              << std::endl;
+}
+
+// Обход через аксессоры; сравните сборки с -DJSON_HEADER_ONLY и без него
+void BenchmarkTraversal() {
+    Array arr;
+    arr.reserve(100'000);
+    for (int i = 0; i < 100'000; ++i) {
+        arr.emplace_back(Dict{
+            {"id"s, Node{i}},
+            {"score"s, Node{i * 0.5}},
+            {"tags"s, Node{Array{Node{1}, Node{2}, Node{3}}}},
+        });
+    }
+    const Document doc{arr};
+
+    const auto start = std::chrono::steady_clock::now();
+    double sum = 0;
+    for (int round = 0; round < 20; ++round) {
+        for (const Node& item : doc.GetRoot().AsArray()) {
+            for (const auto& [key, value] : item.AsMap()) {
+                if (value.IsInt()) {
+                    sum += value.AsInt();
+                } else if (value.IsDouble()) {
+                    sum += value.AsDouble();
+                } else if (value.IsArray()) {
+                    for (const Node& tag : value.AsArray()) {
+                        sum += tag.AsInt();
+                    }
+                }
+            }
+        }
+    }
+    assert(sum > 0);
+    const auto duration = std::chrono::steady_clock::now() - start;
+#ifdef JSON_HEADER_ONLY
+    std::cout << "traversal (header-only): "sv;
+#else
+    std::cout << "traversal (compiled): "sv;
+#endif
+    std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(duration).count() << "ms"sv
+              << std::endl;
+}
+
 }  // namespace
 
 int main() {
@@ -261,5 +915,20 @@ int main() {
     TestArray();
     TestMap();
     TestErrorHandling();
+    TestScatter();
+    TestEmbeddedJson();
+    TestSerializer();
+    TestPathIndex();
+    TestDocumentMutation();
+    TestObservedDocument();
+    TestLoadParallel();
+    TestBlockGzip();
+    TestProjection();
+    TestBlockStats();
+    TestOverlayDocument();
+    TestDiff();
+    TestDedup();
     Benchmark();
+    BenchmarkIndented();
+    BenchmarkTraversal();
 }
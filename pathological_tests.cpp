@@ -0,0 +1,264 @@
+// Adversarial inputs for json::Load and json::Print. Each case is run at several
+// sizes and must show roughly linear growth of time and peak memory.
+// Built as a separate program from main.cpp since it takes a while:
+//   g++ -std=c++20 -O2 pathological_tests.cpp json*.cpp -o pathological_tests -lpthread -lz
+// Pass --full to add the 500 MB string case.
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "json.h"
+
+using namespace std::literals;
+
+namespace {
+
+std::atomic<size_t> live_bytes{0};
+std::atomic<size_t> peak_bytes{0};
+
+}  // namespace
+
+// Track live heap bytes to measure peak memory of a single Load/Print call
+void* operator new(size_t size) {
+    void* ptr = std::malloc(size + sizeof(std::max_align_t));
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    *static_cast<size_t*>(ptr) = size;
+    size_t now = live_bytes.fetch_add(size) + size;
+    size_t peak = peak_bytes.load();
+    while (now > peak && !peak_bytes.compare_exchange_weak(peak, now)) {
+    }
+    return static_cast<char*>(ptr) + sizeof(std::max_align_t);
+}
+
+void operator delete(void* ptr) noexcept {
+    if (ptr != nullptr) {
+        char* base = static_cast<char*>(ptr) - sizeof(std::max_align_t);
+        live_bytes.fetch_sub(*reinterpret_cast<size_t*>(base));
+        std::free(base);
+    }
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+namespace {
+
+// Discards output, counting bytes
+class CountingBuf : public std::streambuf {
+public:
+    size_t Count() const {
+        return count_;
+    }
+
+protected:
+    int_type overflow(int_type c) override {
+        ++count_;
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char*, std::streamsize n) override {
+        count_ += n;
+        return n;
+    }
+
+private:
+    size_t count_ = 0;
+};
+
+struct Measurement {
+    double seconds = 0;
+    size_t peak_bytes = 0;
+};
+
+// Average time of fn over enough runs to last 100ms, and peak heap growth of one run
+Measurement Measure(const std::function<void()>& fn) {
+    Measurement result;
+    size_t base = live_bytes.load();
+    peak_bytes = base;
+    fn();
+    result.peak_bytes = peak_bytes.load() - base;
+
+    int runs = 0;
+    const auto start = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::steady_clock::duration{};
+    do {
+        fn();
+        ++runs;
+        elapsed = std::chrono::steady_clock::now() - start;
+    } while (elapsed < 100ms);
+    result.seconds = std::chrono::duration<double>(elapsed).count() / runs;
+    return result;
+}
+
+std::string DeepArrays(size_t depth) {
+    return std::string(depth, '[') + std::string(depth, ']');
+}
+
+std::string DeepDicts(size_t depth) {
+    std::string text;
+    for (size_t i = 0; i < depth; ++i) {
+        text += "{\"a\":";
+    }
+    text += "null";
+    text += std::string(depth, '}');
+    return text;
+}
+
+std::string LongString(size_t size) {
+    return '"' + std::string(size, 'x') + '"';
+}
+
+std::string EscapedString(size_t size) {
+    std::string text = "\"";
+    while (text.size() < size) {
+        text += "\\n\\t\\\"\\\\a";
+    }
+    return text + '"';
+}
+
+// Dict is an ordered map, so the adversarial keys are the ones that are
+// expensive to compare: long common prefixes differing only at the end
+std::string ManyKeys(size_t count) {
+    const std::string prefix(64, 'k');
+    std::string text = "{";
+    for (size_t i = 0; i < count; ++i) {
+        if (i > 0) {
+            text += ',';
+        }
+        text += '"' + prefix + std::to_string(i) + "\":" + std::to_string(i % 10);
+    }
+    return text + '}';
+}
+
+// The exponent keeps the value within double range
+std::string HugeInteger(size_t digits) {
+    return '1' + std::string(digits, '0') + "e-" + std::to_string(digits);
+}
+
+std::string HugeFraction(size_t digits) {
+    return "0." + std::string(digits, '3') + "e5";
+}
+
+std::string Whitespace(size_t size) {
+    std::string text = "[";
+    while (text.size() < size) {
+        text += std::string(60, ' ') + "\n\t\r" + "1,";
+    }
+    return text + "2]";
+}
+
+json::LoadOptions DeepOptions() {
+    json::LoadOptions options;
+    options.max_depth = 10'000;
+    return options;
+}
+
+// Print is checked in two parts: time per printed byte, and the printed size,
+// which must grow linearly with the input unless printed_size gives its
+// exact value (indenting deep nesting writes O(depth^2) bytes by design)
+void CheckLinear(std::string_view name, const std::function<std::string(size_t)>& make,
+                 std::vector<size_t> sizes, const std::function<size_t(size_t)>& printed_size = nullptr) {
+    std::cout << name << std::endl;
+    const json::LoadOptions options = DeepOptions();
+    double first_load = 0;
+    double first_print = 0;
+    double first_output = 0;
+    double first_memory = 0;
+    for (size_t size : sizes) {
+        const std::string text = make(size);
+
+        Measurement load = Measure([&text, &options] {
+            std::istringstream input(text);
+            json::Load(input, options);
+        });
+
+        std::istringstream input(text);
+        const json::Document doc = json::Load(input, options);
+        CountingBuf sink;
+        std::ostream output(&sink);
+        json::Print(doc, output);
+        const size_t printed = sink.Count();
+        Measurement print = Measure([&doc] {
+            CountingBuf sink;
+            std::ostream output(&sink);
+            json::Print(doc, output);
+        });
+
+        const double load_per_byte = load.seconds / text.size();
+        const double print_per_byte = print.seconds / printed;
+        const double output_per_byte = static_cast<double>(printed) / text.size();
+        const double memory_per_byte = static_cast<double>(load.peak_bytes) / text.size();
+        std::cout << "  " << text.size() << " bytes: load " << load.seconds * 1e3 << "ms, peak "
+                  << load.peak_bytes << " bytes; print " << print.seconds * 1e3 << "ms for " << printed
+                  << " bytes" << std::endl;
+
+        if (printed_size) {
+            assert(printed == printed_size(size));
+        }
+        if (first_load == 0) {
+            first_load = load_per_byte;
+            first_print = print_per_byte;
+            first_output = output_per_byte;
+            first_memory = memory_per_byte;
+            continue;
+        }
+        // Generous bounds: timing noise is fine, a quadratic term is not
+        assert(load_per_byte < first_load * 4);
+        assert(print_per_byte < first_print * 4);
+        assert(printed_size || output_per_byte < first_output * 2);
+        assert(memory_per_byte < first_memory * 2 + 16);
+    }
+}
+
+void CheckDepthLimit() {
+    // Past the nesting limit Load fails cleanly instead of exhausting the stack
+    for (const std::string& text : {DeepArrays(1'000'000), DeepDicts(1'000'000), DeepArrays(1'001)}) {
+        try {
+            std::istringstream input(text);
+            json::Load(input);
+            assert(false);
+        } catch (const json::ParsingError&) {
+            // ok
+        }
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const bool full = argc > 1 && argv[1] == "--full"sv;
+
+    // Every level takes two lines indented by twice its depth
+    CheckLinear("deep arrays"sv, DeepArrays, {1'000, 2'000, 4'000, 8'000}, [](size_t depth) {
+        return 2 * depth * depth;
+    });
+    CheckLinear("deep dicts"sv, DeepDicts, {1'000, 2'000, 4'000, 8'000}, [](size_t depth) {
+        return 2 * depth * depth + 9 * depth + 4;
+    });
+    CheckDepthLimit();
+    std::vector<size_t> string_sizes = {1 << 20, 4 << 20, 16 << 20};
+    if (full) {
+        string_sizes.push_back(500 << 20);
+    }
+    CheckLinear("long string"sv, LongString, string_sizes);
+    CheckLinear("escaped string"sv, EscapedString, {1 << 20, 4 << 20, 16 << 20});
+    CheckLinear("many keys"sv, ManyKeys, {10'000, 100'000, 1'000'000});
+    CheckLinear("huge integer"sv, HugeInteger, {1'000, 10'000, 100'000});
+    CheckLinear("huge fraction"sv, HugeFraction, {1'000, 10'000, 100'000});
+    CheckLinear("whitespace"sv, Whitespace, {1 << 20, 4 << 20, 16 << 20});
+    std::cout << "OK" << std::endl;
+}